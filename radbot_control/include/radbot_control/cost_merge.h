@@ -0,0 +1,73 @@
+/*
+ * cost_merge.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef COST_MERGE_H_
+#define COST_MERGE_H_
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace radbot_control
+{
+
+// Row merges of a layer's cost map into the master grid. Cells holding
+// no_info (costmap_2d::NO_INFORMATION) in src leave dst untouched. Kept
+// free of ROS so the benchmark can run them on their own.
+
+// dst = src wherever src has information.
+inline void overwriteRow(const unsigned char* src, unsigned char* dst, int n, unsigned char no_info)
+{
+  int k = 0;
+#ifdef __SSE2__
+  const __m128i unknown = _mm_set1_epi8((char)no_info);
+  for (; k + 16 <= n; k += 16)
+  {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + k));
+    __m128i d = _mm_loadu_si128((const __m128i*)(dst + k));
+    __m128i skip = _mm_cmpeq_epi8(s, unknown);
+    d = _mm_or_si128(_mm_and_si128(skip, d), _mm_andnot_si128(skip, s));
+    _mm_storeu_si128((__m128i*)(dst + k), d);
+  }
+#endif
+  for (; k < n; k++)
+  {
+    if (src[k] != no_info)
+      dst[k] = src[k];
+  }
+}
+
+// dst = max(dst, src) wherever src has information, as
+// CostmapLayer::updateWithMax: unknown master cells take src.
+inline void maxRow(const unsigned char* src, unsigned char* dst, int n, unsigned char no_info)
+{
+  int k = 0;
+#ifdef __SSE2__
+  const __m128i unknown = _mm_set1_epi8((char)no_info);
+  for (; k + 16 <= n; k += 16)
+  {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + k));
+    __m128i d = _mm_loadu_si128((const __m128i*)(dst + k));
+    __m128i skip = _mm_cmpeq_epi8(s, unknown);
+    __m128i take = _mm_cmpeq_epi8(d, unknown);
+    __m128i merged = _mm_max_epu8(s, d);
+    merged = _mm_or_si128(_mm_and_si128(take, s), _mm_andnot_si128(take, merged));
+    d = _mm_or_si128(_mm_and_si128(skip, d), _mm_andnot_si128(skip, merged));
+    _mm_storeu_si128((__m128i*)(dst + k), d);
+  }
+#endif
+  for (; k < n; k++)
+  {
+    unsigned char s = src[k];
+    if (s == no_info)
+      continue;
+    if (dst[k] == no_info || dst[k] < s)
+      dst[k] = s;
+  }
+}
+
+}
+#endif
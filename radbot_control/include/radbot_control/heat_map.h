@@ -0,0 +1,105 @@
+/*
+ * heat_map.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef HEAT_MAP_H_
+#define HEAT_MAP_H_
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace radbot_control
+{
+
+// Inverse distance weighted heatmap of the counts behind RadLayer, free of
+// ROS so it can be tested on its own. Each measurement adds its Shepard
+// weight w = d^-power and w * cost to two accumulators per cell within
+// kPaintRadius, a cell's cost is their ratio, so it does not depend on the
+// order measurements arrive in. Costs are only resolved for cells painted
+// since the last resolveDirty().
+//
+// paint, clear, resize and resolveDirty must be serialized by the caller,
+// merge may run alongside them.
+class HeatMap
+{
+public:
+  // Heat is kept in kTileSize x kTileSize cell tiles, allocated the first
+  // time a measurement reaches them, so memory and merging scale with the
+  // area surveyed rather than the map.
+  static const int kTileSize = 64;
+
+  // Cells no measurement reached hold no_info (costmap_2d::NO_INFORMATION).
+  explicit HeatMap(unsigned char no_info);
+  ~HeatMap();
+
+  // Drops every measurement and takes the geometry of the master grid,
+  // every cell is dirty.
+  void resize(unsigned int size_x, unsigned int size_y, double resolution, double origin_x, double origin_y);
+  // Drops every measurement and frees the tiles, every cell is dirty.
+  void clear();
+  void setShepardPower(double power);
+  // Pull of every cell toward default_cost, as if a measurement of that
+  // cost had the given Shepard weight in each. 0 leaves it out.
+  void setBackground(double weight, unsigned char default_cost);
+
+  // Adds a measurement of cost (0-254) at world (x, y).
+  void paint(double x, double y, int cost);
+  // Turns the accumulators into costs over the cells painted or cleared
+  // since the last call and reports them, in map cells with exclusive
+  // maxima. False if there were none.
+  bool resolveDirty(int* min_i, int* min_j, int* max_i, int* max_j);
+  // Resolved cost of a cell, no_info where nothing was painted.
+  unsigned char getCost(int i, int j) const;
+  // Merges the resolved costs over [min_i, max_i) x [min_j, max_j) into a
+  // grid of the same geometry, overwriting or keeping the higher cost,
+  // tiles never painted are skipped.
+  void merge(unsigned char* master, int min_i, int min_j, int max_i, int max_j, bool use_max);
+
+  size_t getTileCount() const
+  {
+    return tile_count_;
+  }
+  size_t memoryUsed() const;
+
+private:
+  struct heatTile
+  {
+    // sums of weight * cost and of weight over every measurement. Double,
+    // as the Shepard weights of near and far measurements span many
+    // orders of magnitude
+    double sum_wv[kTileSize * kTileSize];
+    double sum_w[kTileSize * kTileSize];
+    // resolved from the sums for dirty cells only
+    unsigned char cost[kTileSize * kTileSize];
+  };
+  void buildStencil();
+  heatTile* allocateTile(int tx, int ty);
+  void releaseTiles();
+  void markDirty(int min_i, int min_j, int max_i, int max_j);
+
+  unsigned char no_info_;
+  unsigned int size_x_, size_y_;
+  double resolution_, origin_x_, origin_y_;
+  double shepard_;
+  double background_weight_;
+  unsigned char default_cost_;
+  // Shepard weight of a measurement for every cell offset from its cell,
+  // row major, (2 * stencil_cells_ + 1)^2 entries, rebuilt when the
+  // resolution or power changes
+  std::vector<double> stencil_;
+  int stencil_cells_;
+  double stencil_res_;
+  // tiles_x_ * tiles_y_ tiles, row major, NULL until painted. Changed with
+  // tiles_mutex_ held, so merge only needs that
+  std::vector<heatTile*> tiles_;
+  int tiles_x_, tiles_y_;
+  size_t tile_count_;
+  boost::mutex tiles_mutex_;
+  bool dirty_;
+  int dirty_min_i_, dirty_min_j_, dirty_max_i_, dirty_max_j_;
+};
+}
+#endif
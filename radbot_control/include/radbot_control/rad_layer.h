@@ -7,11 +7,23 @@
 #include <dynamic_reconfigure/server.h>
 #include "ursa_driver/ursa_counts.h"
 #include <std_srvs/SetBool.h>
+#include <radbot_control/heat_map.h>
+#include <message_filters/subscriber.h>
+#include <tf/message_filter.h>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
 
 namespace radbot_control
 {
 
-class RadLayer : public costmap_2d::Layer, public costmap_2d::Costmap2D
+// Inverse distance weighted heatmap of the counts (HeatMap). Only the
+// master grid's geometry is kept, the heat lives in sparse tiles, so this
+// is not a Costmap2D. Cells no measurement reached are left out of the
+// merge and keep whatever the master grid holds.
+class RadLayer : public costmap_2d::Layer
 {
 public:
   RadLayer();
@@ -35,16 +47,40 @@ private:
 
   dynamic_reconfigure::Server<costmap_2d::GenericPluginConfig> *dsrv_;
   
-  void countsCB(const ursa_driver::ursa_countsConstPtr counts);
+  // Measurements reach countsCB once their transform is in the tf cache
+  // and are queued for the ingest thread, which localizes and paints them.
+  // The costmap update thread never waits on either.
+  void countsCB(const ursa_driver::ursa_countsConstPtr& counts);
+  void ingestLoop();
+  void processCounts(const ursa_driver::ursa_countsConstPtr& counts);
   void paintCostmap(double x, double y, int cost);
 
+  // master grid geometry, copied by matchSize
+  double resolution_, origin_x_, origin_y_;
+
   std::string global_frame_;
-  ros::Subscriber counts_sub_;
+  message_filters::Subscriber<ursa_driver::ursa_counts> counts_sub_;
+  tf::MessageFilter<ursa_driver::ursa_counts>* counts_filter_;
+  // Single producer: counts_filter_ calls countsCB from the global
+  // callback queue, which move_base spins on one thread, and the ingest
+  // thread is the only consumer. A multi-threaded spinner or a second
+  // subscriber pushing here would need an MPSC queue.
+  boost::lockfree::spsc_queue<ursa_driver::ursa_countsConstPtr> ingest_queue_;
+  // wakes the ingest thread, the mutex only orders the wait against a push
+  boost::mutex ingest_mutex_;
+  boost::condition_variable ingest_ready_;
+  unsigned long ingest_dropped_; // counts lost to a full queue
+  boost::thread ingest_thread_;
   tf::TransformListener tf_listener_;
   int current_cost_;
   int max_rad_;
   double shepard_;
   double min_dist_;
+  int combination_method_; // 0 overwrites the master, 1 keeps the higher cost
+  double background_weight_; // pull of every cell toward the default cost
+  // painted by the ingest thread, resolved and merged on the update thread
+  HeatMap heat_;
+  boost::mutex mutex_; // serializes painting, clearing and resolving heat_
   tf::Vector3 last_measure_;
   bool enabled_;
   ros::ServiceServer enableService_;
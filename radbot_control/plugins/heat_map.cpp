@@ -0,0 +1,248 @@
+#include <radbot_control/heat_map.h>
+#include <radbot_control/cost_merge.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// half width of the square painted around each measurement
+static const double kPaintRadius = 5.0;
+
+namespace radbot_control
+{
+
+  HeatMap::HeatMap(unsigned char no_info) :
+      no_info_(no_info), size_x_(0), size_y_(0), resolution_(0), origin_x_(0), origin_y_(0), shepard_(5),
+      background_weight_(0), default_cost_(0), stencil_cells_(0), stencil_res_(0), tiles_x_(0), tiles_y_(0),
+      tile_count_(0), dirty_(false) {}
+  HeatMap::~HeatMap()
+  {
+    releaseTiles();
+  }
+
+  void HeatMap::resize(unsigned int size_x, unsigned int size_y, double resolution, double origin_x, double origin_y)
+  {
+    releaseTiles();
+    size_x_ = size_x;
+    size_y_ = size_y;
+    resolution_ = resolution;
+    origin_x_ = origin_x;
+    origin_y_ = origin_y;
+    tiles_x_ = (size_x_ + kTileSize - 1) / kTileSize;
+    tiles_y_ = (size_y_ + kTileSize - 1) / kTileSize;
+    boost::mutex::scoped_lock lock(tiles_mutex_);
+    tiles_.assign(tiles_x_ * tiles_y_, NULL);
+    markDirty(0, 0, size_x_, size_y_);
+  }
+
+  void HeatMap::clear()
+  {
+    releaseTiles();
+    markDirty(0, 0, size_x_, size_y_);
+  }
+
+  void HeatMap::setShepardPower(double power)
+  {
+    shepard_ = power;
+    stencil_res_ = 0;
+  }
+
+  void HeatMap::setBackground(double weight, unsigned char default_cost)
+  {
+    background_weight_ = weight;
+    default_cost_ = default_cost;
+  }
+
+  // d runs from the measurement, snapped to a cell corner, to the cell
+  // centre, so it is never 0. The weight only depends on the cell offset,
+  // so it is tabled once per resolution.
+  void HeatMap::buildStencil()
+  {
+    stencil_res_ = resolution_;
+    stencil_cells_ = kPaintRadius / stencil_res_;
+    int n = stencil_cells_;
+    int width = 2 * n + 1;
+    stencil_.resize(width * width);
+    for (int dj = -n; dj <= n; dj++)
+    {
+      for (int di = -n; di <= n; di++)
+      {
+        double distance = hypot(di + 0.5, dj + 0.5) * stencil_res_;
+        stencil_[(dj + n) * width + di + n] = pow(distance, -shepard_);
+      }
+    }
+  }
+
+  void HeatMap::paint(double x, double y, int cost)
+  {
+    if (resolution_ <= 0)
+      return;
+    if (resolution_ != stencil_res_)
+      buildStencil();
+    int n = stencil_cells_;
+    int width = 2 * n + 1;
+    //the measurement snaps to the nearest cell corner
+    int ci = floor((x - origin_x_) / stencil_res_ + 0.5);
+    int cj = floor((y - origin_y_) / stencil_res_ + 0.5);
+    int min_i = std::max(ci - n, 0);
+    int max_i = std::min(ci + n + 1, (int)size_x_);
+    int min_j = std::max(cj - n, 0);
+    int max_j = std::min(cj + n + 1, (int)size_y_);
+    if (min_i >= max_i || min_j >= max_j)
+      return;
+    const double value = cost;
+
+    //one contiguous run of cells and weights per tile row
+    for (int ty = min_j / kTileSize; ty <= (max_j - 1) / kTileSize; ty++)
+    {
+      for (int tx = min_i / kTileSize; tx <= (max_i - 1) / kTileSize; tx++)
+      {
+        heatTile* tile = allocateTile(tx, ty);
+        int i0 = std::max(min_i, tx * kTileSize), i1 = std::min(max_i, (tx + 1) * kTileSize);
+        int j0 = std::max(min_j, ty * kTileSize), j1 = std::min(max_j, (ty + 1) * kTileSize);
+        for (int j = j0; j < j1; j++)
+        {
+          int index = (j - ty * kTileSize) * kTileSize + i0 - tx * kTileSize;
+          double *sum_wv = tile->sum_wv + index;
+          double *sum_w = tile->sum_w + index;
+          const double *weight = &stencil_[(j - cj + n) * width + i0 - ci + n];
+          for (int k = 0; k < i1 - i0; k++)
+          {
+            sum_wv[k] += weight[k] * value;
+            sum_w[k] += weight[k];
+          }
+        }
+      }
+    }
+    markDirty(min_i, min_j, max_i, max_j);
+  }
+
+  // The tile holding tile coordinates (tx, ty), allocated on first use with
+  // every cell unknown.
+  HeatMap::heatTile* HeatMap::allocateTile(int tx, int ty)
+  {
+    heatTile*& tile = tiles_[ty * tiles_x_ + tx];
+    if (tile)
+      return tile;
+    heatTile* fresh = new heatTile();
+    memset(fresh->cost, no_info_, sizeof(fresh->cost));
+    boost::mutex::scoped_lock lock(tiles_mutex_);
+    tile = fresh;
+    tile_count_++;
+    return tile;
+  }
+
+  void HeatMap::releaseTiles()
+  {
+    boost::mutex::scoped_lock lock(tiles_mutex_);
+    for (size_t t = 0; t < tiles_.size(); t++)
+    {
+      delete tiles_[t];
+      tiles_[t] = NULL;
+    }
+    tile_count_ = 0;
+  }
+
+  size_t HeatMap::memoryUsed() const
+  {
+    return tile_count_ * sizeof(heatTile) + tiles_.size() * sizeof(heatTile*);
+  }
+
+  // Cells no measurement reached stay unknown and the merge skips them.
+  bool HeatMap::resolveDirty(int* min_i, int* min_j, int* max_i, int* max_j)
+  {
+    if (!dirty_)
+      return false;
+    const double background = background_weight_;
+    const double prior = background_weight_ * default_cost_;
+    for (int ty = dirty_min_j_ / kTileSize; ty <= (dirty_max_j_ - 1) / kTileSize; ty++)
+    {
+      for (int tx = dirty_min_i_ / kTileSize; tx <= (dirty_max_i_ - 1) / kTileSize; tx++)
+      {
+        heatTile* tile = tiles_[ty * tiles_x_ + tx];
+        if (!tile)
+          continue;
+        int i0 = std::max(dirty_min_i_, tx * kTileSize), i1 = std::min(dirty_max_i_, (tx + 1) * kTileSize);
+        int j0 = std::max(dirty_min_j_, ty * kTileSize), j1 = std::min(dirty_max_j_, (ty + 1) * kTileSize);
+        for (int j = j0; j < j1; j++)
+        {
+          int index = (j - ty * kTileSize) * kTileSize + i0 - tx * kTileSize;
+          unsigned char *row = tile->cost + index;
+          const double *sum_wv = tile->sum_wv + index;
+          const double *sum_w = tile->sum_w + index;
+          for (int k = 0; k < i1 - i0; k++)
+          {
+            double cost = (sum_wv[k] + prior) / (sum_w[k] + background);
+            row[k] = sum_w[k] > 0 ? (unsigned char)std::min(cost + 0.5, 254.0) : no_info_;
+          }
+        }
+      }
+    }
+    *min_i = dirty_min_i_;
+    *min_j = dirty_min_j_;
+    *max_i = dirty_max_i_;
+    *max_j = dirty_max_j_;
+    dirty_ = false;
+    return true;
+  }
+
+  unsigned char HeatMap::getCost(int i, int j) const
+  {
+    if (i < 0 || j < 0 || i >= (int)size_x_ || j >= (int)size_y_)
+      return no_info_;
+    const heatTile* tile = tiles_[(j / kTileSize) * tiles_x_ + i / kTileSize];
+    return tile ? tile->cost[(j % kTileSize) * kTileSize + i % kTileSize] : no_info_;
+  }
+
+  void HeatMap::markDirty(int min_i, int min_j, int max_i, int max_j)
+  {
+    if (min_i >= max_i || min_j >= max_j)
+      return;
+    if (!dirty_)
+    {
+      dirty_min_i_ = min_i;
+      dirty_min_j_ = min_j;
+      dirty_max_i_ = max_i;
+      dirty_max_j_ = max_j;
+      dirty_ = true;
+      return;
+    }
+    dirty_min_i_ = std::min(dirty_min_i_, min_i);
+    dirty_min_j_ = std::min(dirty_min_j_, min_j);
+    dirty_max_i_ = std::max(dirty_max_i_, max_i);
+    dirty_max_j_ = std::max(dirty_max_j_, max_j);
+  }
+
+  void HeatMap::merge(unsigned char* master, int min_i, int min_j, int max_i, int max_j, bool use_max)
+  {
+    min_i = std::max(min_i, 0);
+    min_j = std::max(min_j, 0);
+    max_i = std::min(max_i, (int)size_x_);
+    max_j = std::min(max_j, (int)size_y_);
+    if (min_i >= max_i || min_j >= max_j)
+      return;
+    //merge the populated tiles a row at a time, painting only holds
+    //tiles_mutex_ to add a tile
+    boost::mutex::scoped_lock lock(tiles_mutex_);
+    for (int ty = min_j / kTileSize; ty <= (max_j - 1) / kTileSize; ty++)
+    {
+      for (int tx = min_i / kTileSize; tx <= (max_i - 1) / kTileSize; tx++)
+      {
+        const heatTile* tile = tiles_[ty * tiles_x_ + tx];
+        if (!tile)
+          continue;
+        int i0 = std::max(min_i, tx * kTileSize), i1 = std::min(max_i, (tx + 1) * kTileSize);
+        int j0 = std::max(min_j, ty * kTileSize), j1 = std::min(max_j, (ty + 1) * kTileSize);
+        for (int j = j0; j < j1; j++)
+        {
+          const unsigned char* src = tile->cost + (j - ty * kTileSize) * kTileSize + i0 - tx * kTileSize;
+          unsigned char* dst = master + j * size_x_ + i0;
+          if (use_max)
+            maxRow(src, dst, i1 - i0, no_info_);
+          else
+            overwriteRow(src, dst, i1 - i0, no_info_);
+        }
+      }
+    }
+  }
+
+}
@@ -1,5 +1,6 @@
 #include<radbot_control/rad_layer.h>
 #include <pluginlib/class_list_macros.h>
+#include <algorithm>
 
 
 PLUGINLIB_EXPORT_CLASS(radbot_control::RadLayer, costmap_2d::Layer)
@@ -8,17 +9,27 @@ using costmap_2d::LETHAL_OBSTACLE;
 using costmap_2d::NO_INFORMATION;
 using costmap_2d::FREE_SPACE;
 
+// measurements waiting for the ingest thread
+static const int kIngestQueueSize = 256;
+
 namespace radbot_control
 {
 
-  RadLayer::RadLayer() {}
-  RadLayer::~RadLayer() {}
+  RadLayer::RadLayer() :
+      resolution_(0), origin_x_(0), origin_y_(0), counts_filter_(NULL), ingest_queue_(kIngestQueueSize),
+      ingest_dropped_(0), heat_(NO_INFORMATION) {}
+  RadLayer::~RadLayer()
+  {
+    ingest_thread_.interrupt();
+    ingest_thread_.join();
+    counts_sub_.unsubscribe();
+    delete counts_filter_;
+  }
 
   void RadLayer::onInitialize()
   {
     ros::NodeHandle nh("~/" + name_);
     current_ = true;
-    default_value_ = FREE_SPACE;
     matchSize();
 
     global_frame_ = layered_costmap_->getGlobalFrameID();
@@ -29,14 +40,23 @@ namespace radbot_control
     nh.param<int>("max_counts", max_rad_, 50000);
     nh.param<double>("shepard_power", shepard_, 5);
     nh.param<double>("measure_dist", min_dist_, .3);
+    nh.param<int>("combination_method", combination_method_, 0);
+    nh.param<double>("background_weight", background_weight_, 0);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      heat_.setShepardPower(shepard_);
+      heat_.setBackground(background_weight_, FREE_SPACE);
+    }
     
     current_cost_ = 0;
-    counts_sub_ = nh.subscribe("/ursa_node/counts", 1, &RadLayer::countsCB, this);  
+    counts_sub_.subscribe(nh, "/ursa_node/counts", 10);
+    counts_filter_ = new tf::MessageFilter<ursa_driver::ursa_counts>(counts_sub_, tf_listener_, global_frame_, 50, nh);
+    counts_filter_->registerCallback(boost::bind(&RadLayer::countsCB, this, _1));
     enableService_ = nh.advertiseService("heatmap_enable", &RadLayer::enableCB, this);
     
     last_measure_.setZero();
     enabled_ = true;
-    
+    ingest_thread_ = boost::thread(boost::bind(&RadLayer::ingestLoop, this));
   }
   
   bool RadLayer::enableCB(std_srvs::SetBool::Request& request, std_srvs::SetBool::Response& response){
@@ -52,14 +72,50 @@ namespace radbot_control
   return true;
   }
   
-  void RadLayer::countsCB(const ursa_driver::ursa_countsConstPtr counts){
+  void RadLayer::countsCB(const ursa_driver::ursa_countsConstPtr& counts){
+    if (!ingest_queue_.push(counts))
+    {
+      ingest_dropped_++;
+      ROS_WARN_THROTTLE(5.0, "RadLayer: ingest queue full, %lu counts dropped so far", ingest_dropped_);
+      return;
+    }
+    //taking the mutex orders the push before a wait that saw the queue empty
+    {
+      boost::mutex::scoped_lock lock(ingest_mutex_);
+    }
+    ingest_ready_.notify_one();
+  }
+
+  void RadLayer::ingestLoop()
+  {
+    ursa_driver::ursa_countsConstPtr counts;
+    while (true)
+    {
+      while (ingest_queue_.pop(counts))
+        processCounts(counts);
+      //the wait is an interruption point, the destructor stops the thread here
+      boost::mutex::scoped_lock lock(ingest_mutex_);
+      while (!ingest_queue_.read_available())
+        ingest_ready_.wait(lock);
+    }
+  }
+
+  void RadLayer::processCounts(const ursa_driver::ursa_countsConstPtr& counts){
     //ROS_INFO("cost %d, counts %d", current_cost_, counts->counts);
     //if (counts->counts>max_rad_) max_rad_=counts->counts;
     current_cost_ = 255*counts->counts/max_rad_;
     if(current_cost_ > 254) current_cost_ = 254;
+    //the filter only lets counts through once their transform is cached
     tf::StampedTransform robot_pose;
-    tf_listener_.waitForTransform(global_frame_, counts->header.frame_id, ros::Time(0), ros::Duration(3.0));
-    tf_listener_.lookupTransform(global_frame_, counts->header.frame_id, ros::Time(0), robot_pose);
+    try
+    {
+      tf_listener_.lookupTransform(global_frame_, counts->header.frame_id, counts->header.stamp, robot_pose);
+    }
+    catch (tf::TransformException& ex)
+    {
+      ROS_WARN_THROTTLE(5.0, "RadLayer: %s", ex.what());
+      return;
+    }
     
     tfScalar dist = robot_pose.getOrigin().distance(last_measure_);
     
@@ -71,51 +127,23 @@ namespace radbot_control
   }
 
   void RadLayer::paintCostmap(double x, double y, int cost){
-    double i_meter, j_meter, distance, originX, originY;
-    double res = getResolution();
-    originX = getOriginX();
-    originY = getOriginY();
-    int max_i = (x + 5 - originX)/res;
-    int max_j = (y + 5 - originY)/res;
-    int min_i = (x - 5 - originX)/res;
-    int min_j = (y - 5 - originY)/res;
-    double weight=0;
-    int new_cost;
-
-    for (int i = min_i; i< max_i; i++)
-    {
-      i_meter = originX + i * res;
-      for (int j = min_j; j < max_j; j++)
-      {
-        j_meter = originY + j * res;
-        distance = pow((pow(i_meter - x, 2) + pow(j_meter - y, 2)), 0.5);
-        if (distance < res * 4)
-        {
-          setCost(i,j,cost);
-        }
-        else
-        {
-          weight = 1/(pow(distance, shepard_)*3);
-          
-        }
-        //if (distance > 2)
-        //{
-        //  weight *= .25;
-        //}
-        new_cost = ((weight * cost) + 5*getCost(i,j)) / ((weight + 5));
-          if(new_cost > 254) new_cost = 254;
-          setCost(i,j,new_cost);
-      }
-    }
-  
+    boost::mutex::scoped_lock lock(mutex_);
+    size_t tiles = heat_.getTileCount();
+    heat_.paint(x, y, cost);
+    if (heat_.getTileCount() != tiles)
+      ROS_INFO_THROTTLE(10.0, "RadLayer: heatmap uses %lu tiles, %.1f MB", (unsigned long)heat_.getTileCount(),
+                        heat_.memoryUsed() / 1048576.0);
   }
 
-
   void RadLayer::matchSize()
   {
-    Costmap2D* master = layered_costmap_->getCostmap();
-    resizeMap(master->getSizeInCellsX(), master->getSizeInCellsY(), master->getResolution(),
-              master->getOriginX(), master->getOriginY());
+    boost::mutex::scoped_lock lock(mutex_);
+    //geometry only, the heat lives in tiles
+    costmap_2d::Costmap2D* master = layered_costmap_->getCostmap();
+    resolution_ = master->getResolution();
+    origin_x_ = master->getOriginX();
+    origin_y_ = master->getOriginY();
+    heat_.resize(master->getSizeInCellsX(), master->getSizeInCellsY(), resolution_, origin_x_, origin_y_);
   }
 
 
@@ -127,42 +155,36 @@ namespace radbot_control
   void RadLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
                                              double* min_y, double* max_x, double* max_y)
   {
-    if (!enabled_)
+    //only cells painted or reset since the last cycle need redrawing,
+    //a reset while disabled still clears the heatmap from the master.
+    //Mid paint they wait for the next cycle rather than stall this one
+    boost::mutex::scoped_lock lock(mutex_, boost::try_to_lock);
+    int min_i, min_j, max_i, max_j;
+    if (!lock.owns_lock() || !heat_.resolveDirty(&min_i, &min_j, &max_i, &max_j))
       return;
-
-        //update the whole costmap
-        *min_x = getOriginX();
-        *min_y = getOriginY();
-        *max_x = getSizeInMetersX()+getOriginX();
-        *max_y = getSizeInMetersY()+getOriginY(); 
-        
-        //ROS_WARN("min x: %f min : %f, max x: %f max y: %f", *min_x, *min_y, *max_x, *max_y);
+    double res = resolution_;
+    *min_x = std::min(*min_x, origin_x_ + min_i * res);
+    *min_y = std::min(*min_y, origin_y_ + min_j * res);
+    *max_x = std::max(*max_x, origin_x_ + max_i * res);
+    *max_y = std::max(*max_y, origin_y_ + max_j * res);
   }
 
   void RadLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i,
                                             int max_j)
   {
-    if (!enabled_)
+    if (!enabled_ || min_i >= max_i || min_j >= max_j)
       return;
 
-    for (int j = min_j; j < max_j; j++)
-    {
-      for (int i = min_i; i < max_i; i++)
-      {
-        int index = getIndex(i, j);
-        if (costmap_[index] == NO_INFORMATION)
-          continue;
-        master_grid.setCost(i, j, costmap_[index]); 
-      }
-    }
+    //both maps share size and origin
+    heat_.merge(master_grid.getCharMap(), min_i, min_j, max_i, max_j, combination_method_ == 1);
   }
   
   void RadLayer::reset(){
 
-      //reset costmap_ char array to default values
-      memset(costmap_, default_value_, size_x_ * size_y_ * sizeof(unsigned char));
-
+      //drop every measurement and its memory, the master is cleared in
+      //the next update
+      boost::mutex::scoped_lock lock(mutex_);
+      heat_.clear();
   }
 
 } // end namespace
-
@@ -15,6 +15,8 @@
 #include "frontier_exploration/ExploreTaskActionGoal.h"
 #include "frontier_exploration/ExploreTaskActionResult.h"
 #include <move_base_msgs/MoveBaseAction.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
 //costmap
 #include <tf/transform_listener.h>
 #include <tf/transform_datatypes.h>
@@ -31,16 +33,52 @@ ros::Publisher pub;
 ros::Publisher marker_pub;
 ros::Publisher marker_text_pub;
 bool automode = false;
-int num_src = 1;
+int num_src = 1; //0 lets the processor pick 1..max_sources
+int max_sources;
 int particles;
 int num_samples;
+bool pso_after_sample;
+bool pso_running = false;
+bool pso_pending = false; //rerun once the current solve finishes
+int pso_goal = 0; //id of the newest solve, results of older ones are dropped
+ros::Time pso_sent;
+double pso_timeout; //a solve running longer is taken as lost
+boost::mutex pso_mutex; //never held across psoAc calls
 std::string frame;
+
+//sampling state, the robot is held still by hold_timer while kSampling.
+//sample_mutex is never held across sampler calls, the action client runs
+//sampleDoneCB under its own lock
+enum samplePhase
+{
+    kIdle, kSampling
+};
+samplePhase sample_phase = kIdle;
+int sample_attempt; //ignores results from abandoned attempts
+int sample_retries;
+double sample_timeout;
+ros::Time sample_start;
+ros::Timer hold_timer; //stops itself once idle
+ros::Timer pso_timer; //periodic solves for continuous surveys
+boost::mutex sample_mutex;
 visualization_msgs::Marker sample_marker;
 
 void getSample();
+void sendSample(int attempt);
+int retryOrFail();
+void holdTimerCB(const ros::TimerEvent &event);
+void sampleDoneCB(const actionlib::SimpleClientGoalState &state,
+                  const radbot_processor::sampleResultConstPtr &result,
+                  int attempt);
 void moveBaseCB(const move_base_msgs::MoveBaseActionResultConstPtr ptr);
 bool psoCB(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
 void runPso();
+bool psoLost(const ros::Time &sent);
+void psoDoneCB(const actionlib::SimpleClientGoalState &state,
+               const radbot_processor::psoResultConstPtr &result, int goal_id);
+void psoFeedbackCB(const radbot_processor::psoFeedbackConstPtr &feedback);
+void psoTimerCB(const ros::TimerEvent &event);
+void publishSources(const std::vector<double> &params);
 bool enableCB(radbot_control::Autosample::Request &req,
               radbot_control::Autosample::Response &res);
 bool manualCB(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
@@ -52,7 +90,8 @@ void setHomeCB(const frontier_exploration::ExploreTaskActionGoalConstPtr ptr);
 void goHomeCB(const frontier_exploration::ExploreTaskActionResultConstPtr ptr);
 
 actionlib::SimpleActionClient<radbot_processor::sampleAction> * sampler;
-actionlib::SimpleActionClient<radbot_processor::psoAction> * psoAc;
+typedef actionlib::SimpleActionClient<radbot_processor::psoAction> psoClient;
+psoClient * psoAc;
 actionlib::SimpleActionClient<move_base_msgs::MoveBaseAction> * move_client;
 
 int main(int argc, char** argv) {
@@ -60,8 +99,21 @@ int main(int argc, char** argv) {
     ros::NodeHandle nh;
     ros::NodeHandle pnh("~");
 
-    pnh.param("num_particles", particles, 5000);
+    pnh.param("num_particles", particles, 100);
     pnh.param("num_samples", num_samples, 10);
+    pnh.param("max_sources", max_sources, 3);
+    pnh.param("pso_after_sample", pso_after_sample, false);
+    pnh.param("sample_timeout", sample_timeout, 30.0);
+    pnh.param("sample_retries", sample_retries, 2);
+    double hold_rate;
+    pnh.param("hold_rate", hold_rate, 10.0);
+    hold_timer = nh.createTimer(ros::Duration(1.0 / hold_rate), &holdTimerCB,
+                                false, false);
+    double pso_period;
+    pnh.param("pso_period", pso_period, 0.0);
+    pnh.param("pso_timeout", pso_timeout, 600.0);
+    if (pso_period > 0)
+        pso_timer = nh.createTimer(ros::Duration(pso_period), &psoTimerCB);
     pnh.param<std::string>("marker_frame", frame, "odom");
 
     move_sub = pnh.subscribe<move_base_msgs::MoveBaseActionResult>(
@@ -95,8 +147,7 @@ int main(int argc, char** argv) {
     //actions
     sampler = new actionlib::SimpleActionClient<radbot_processor::sampleAction>(
             "process_sampler", true);
-    psoAc = new actionlib::SimpleActionClient<radbot_processor::psoAction>(
-            "process_pso", true);
+    psoAc = new psoClient("process_pso", true);
     move_client = new actionlib::SimpleActionClient<move_base_msgs::MoveBaseAction>(
             "move_base", true);
     psoAc->waitForServer();
@@ -123,11 +174,7 @@ int main(int argc, char** argv) {
     rad_costmap_ros->resetLayers();
 
     ROS_INFO("Control running");
-    ros::Rate rate(10.0);
-    while (ros::ok()) {
-        ros::spinOnce();
-        rate.sleep();
-    }
+    ros::spin();
 
     return 0;
 }
@@ -161,33 +208,106 @@ void goHomeCB(const frontier_exploration::ExploreTaskActionResultConstPtr ptr) {
     ROS_DEBUG_STREAM("go home");
 }
 
+// Starts a stop-and-sample, returns at once. The hold timer keeps the base
+// still until sampleDoneCB, and times out or retries stuck attempts.
 void getSample() {
-    ROS_INFO("Control: Getting Sample");
+    {
+        boost::mutex::scoped_lock lock(sample_mutex);
+        if (sample_phase != kIdle) {
+            ROS_WARN("Control: Sample already in progress");
+            return;
+        }
+        ROS_INFO("Control: Getting Sample");
+        sample_attempt = 0;
+        sample_phase = kSampling;
+        sample_start = ros::Time::now();
+    }
+    pub.publish(geometry_msgs::Twist());
+    hold_timer.start();
+    sendSample(0);
+}
+
+// Sends the goal for an attempt, unless it was abandoned meanwhile.
+void sendSample(int attempt) {
+    {
+        boost::mutex::scoped_lock lock(sample_mutex);
+        if (sample_phase != kSampling || attempt != sample_attempt)
+            return;
+    }
     radbot_processor::sampleGoal goal;
-    radbot_processor::sampleResult result;
     goal.samples = num_samples;
-    geometry_msgs::Twist msg;
-    msg.linear.x = 0;
-    msg.linear.y = 0;
-    msg.linear.z = 0;
-    msg.angular.x = 0;
-    msg.angular.y = 0;
-    msg.angular.z = 0;
-    pub.publish(msg);
-    sampler->sendGoal(goal);
-    while (!sampler->getState().isDone()) {
-        pub.publish(msg);
+    sampler->sendGoal(goal, boost::bind(&sampleDoneCB, _1, _2, attempt));
+}
+
+// Moves on to the next attempt or gives up on the sample, under
+// sample_mutex. Returns the attempt to send once it is released, -1 for
+// none.
+int retryOrFail() {
+    if (sample_attempt < sample_retries) {
+        sample_attempt++;
+        sample_start = ros::Time::now();
+        ROS_WARN("Control: Retrying sample, attempt %d of %d",
+                 sample_attempt + 1, sample_retries + 1);
+        return sample_attempt;
     }
-    result = *sampler->getResult();
-    geometry_msgs::Point temp_point;
-    temp_point.x = result.x;
-    temp_point.y = result.y;
-    temp_point.z = 0;
-    sample_marker.points.push_back(temp_point);
-    sample_marker.header.stamp = ros::Time::now();
-    marker_pub.publish(sample_marker);
+    ROS_ERROR("Control: Sample failed after %d attempts", sample_attempt + 1);
+    sample_phase = kIdle;
+    return -1;
+}
+
+void holdTimerCB(const ros::TimerEvent &event) {
+    int retry;
+    {
+        boost::mutex::scoped_lock lock(sample_mutex);
+        if (sample_phase != kSampling) {
+            hold_timer.stop();
+            return;
+        }
+        if (sample_timeout <= 0
+                || (ros::Time::now() - sample_start).toSec() <= sample_timeout) {
+            pub.publish(geometry_msgs::Twist());
+            return;
+        }
+        ROS_WARN("Control: Sample timed out");
+        retry = retryOrFail();
+    }
+    sampler->cancelGoal();
+    if (retry >= 0)
+        sendSample(retry);
+}
+
+void sampleDoneCB(const actionlib::SimpleClientGoalState &state,
+                  const radbot_processor::sampleResultConstPtr &result,
+                  int attempt) {
+    bool done = false;
+    int retry = -1;
+    {
+        boost::mutex::scoped_lock lock(sample_mutex);
+        if (sample_phase != kSampling || attempt != sample_attempt)
+            return;
+        if (state != actionlib::SimpleClientGoalState::SUCCEEDED || !result) {
+            ROS_WARN_STREAM("Control: Sample " << state.toString());
+            retry = retryOrFail();
+        }
+        else {
+            sample_phase = kIdle;
+            done = true;
+            geometry_msgs::Point temp_point;
+            temp_point.x = result->x;
+            temp_point.y = result->y;
+            temp_point.z = 0;
+            sample_marker.points.push_back(temp_point);
+            sample_marker.header.stamp = ros::Time::now();
+            marker_pub.publish(sample_marker);
+        }
+    }
+    if (retry >= 0)
+        sendSample(retry);
+    if (!done)
+        return;
     ROS_INFO("Control: Finished Getting Sample");
-    //runPso();
+    if (pso_after_sample)
+        runPso();
 }
 
 bool psoCB(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res) {
@@ -195,16 +315,90 @@ bool psoCB(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res) {
     return true;
 }
 
+// Sends the solve without waiting, results arrive in psoDoneCB on the
+// action client's thread. A request while a solve is running is folded
+// into one rerun so it sees the newest samples, unless that solve looks
+// lost, then it is replaced. The action client takes its own lock around
+// the callbacks, so it is only called with pso_mutex released.
 void runPso() {
+    bool running;
+    ros::Time sent;
+    {
+        boost::mutex::scoped_lock lock(pso_mutex);
+        running = pso_running;
+        sent = pso_sent;
+    }
+    bool lost = running && psoLost(sent);
+    int goal_id;
+    {
+        boost::mutex::scoped_lock lock(pso_mutex);
+        if (pso_running && !lost) {
+            ROS_INFO("Control: PSO busy, queued a rerun");
+            pso_pending = true;
+            return;
+        }
+        if (lost)
+            ROS_WARN("Control: PSO result lost, sending a new solve");
+        pso_running = true;
+        pso_pending = false;
+        pso_sent = ros::Time::now();
+        goal_id = ++pso_goal;
+    }
     ROS_INFO("Control: Running PSO");
     radbot_processor::psoGoal goal;
     goal.numSrc = num_src;
+    goal.maxSrc = num_src > 0 ? 0 : max_sources;
     goal.particles = particles;
-    psoAc->sendGoal(goal);
-    psoAc->waitForResult();  //comment below line to not hang while running
-    radbot_processor::psoResult state = *psoAc->getResult();
-    ROS_WARN_STREAM("Control: Pso Results: " << state);
+    psoAc->sendGoal(goal, boost::bind(&psoDoneCB, _1, _2, goal_id),
+                    psoClient::SimpleActiveCallback(), &psoFeedbackCB);
+}
+
+// True if the running solve will never report back: the processor went
+// away, the goal finished without its done callback, or it overran
+// pso_timeout.
+bool psoLost(const ros::Time &sent) {
+    if (!psoAc->isServerConnected())
+        return true;
+    if (psoAc->getState().isDone())
+        return true;
+    return pso_timeout > 0 && (ros::Time::now() - sent).toSec() > pso_timeout;
+}
+
+void psoDoneCB(const actionlib::SimpleClientGoalState &state,
+               const radbot_processor::psoResultConstPtr &result, int goal_id) {
+    bool rerun;
+    {
+        boost::mutex::scoped_lock lock(pso_mutex);
+        if (goal_id != pso_goal)
+            return; //replaced after it was taken as lost
+        pso_running = false;
+        rerun = pso_pending;
+        pso_pending = false;
+    }
+    if (result) {
+        ROS_WARN_STREAM("Control: Pso Results: " << *result);
+        if (!result->params.empty())
+            publishSources(result->params);
+    }
+    else
+        ROS_ERROR_STREAM("Control: Pso " << state.toString());
+    if (rerun)
+        runPso();
+}
 
+void psoTimerCB(const ros::TimerEvent &event) {
+    runPso();
+}
+
+// Intermediate estimates, so the markers track the solve as it converges.
+void psoFeedbackCB(const radbot_processor::psoFeedbackConstPtr &feedback) {
+    ROS_DEBUG_STREAM(
+            "Control: Pso iter " << feedback->iteration << " cost "
+                    << feedback->cost);
+    publishSources(feedback->params);
+}
+
+void publishSources(const std::vector<double> &params) {
     visualization_msgs::Marker marker;
     marker.header.frame_id = frame;
 
@@ -238,21 +432,21 @@ void runPso() {
     marker_text.color.b = 1.0f;
     marker_text.color.a = 1.0;
     marker_text.lifetime = ros::Duration(3600);
-    for (int i = 0; i < state.params.size() / 3; i++) {
+    for (int i = 0; i < (int) params.size() / 3; i++) {
         geometry_msgs::Point temp_point;
 
-        temp_point.x = state.params[0 + i * 3];
-        temp_point.y = state.params[1 + i * 3];
+        temp_point.x = params[0 + i * 3];
+        temp_point.y = params[1 + i * 3];
         temp_point.z = 0;
 
         marker.points.push_back(temp_point);
 
         marker_text.id = i;
         marker_text.header.stamp = ros::Time::now();
-        marker_text.pose.position.x = state.params[0 + i * 3];
-        marker_text.pose.position.y = state.params[1 + i * 3];
+        marker_text.pose.position.x = params[0 + i * 3];
+        marker_text.pose.position.y = params[1 + i * 3];
         char buff[50];
-        sprintf(buff, "Source #%d, CPS: %d", i+1, (int)state.params[2 + i * 3]);
+        sprintf(buff, "Source #%d, CPS: %d", i+1, (int)params[2 + i * 3]);
         marker_text.text = buff;
         marker_text_array.markers.push_back(marker_text);
     }
@@ -295,7 +489,11 @@ bool sampleMarkerCB(std_srvs::Empty::Request &req, std_srvs::Empty::Response &re
     marker.action = 2; //delete
     marker.ns = "basic_shapes";
     marker.id = 1;
-    sample_marker.points.clear();
+    {
+        boost::mutex::scoped_lock lock(sample_mutex);
+        sample_marker.points.clear();
+    }
     marker_pub.publish(marker);
+    return true;
 }
 
@@ -0,0 +1,103 @@
+/*
+ * rad_layer_bench.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  Microbenchmark for the RadLayer merge into the master grid. Runs the
+ *  original per-cell loop and the row merges over a full square grid,
+ *  checks they agree and reports milliseconds per merge.
+ *
+ *  usage: rad_layer_bench [cells per side] [repeats]
+ */
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "radbot_control/cost_merge.h"
+
+using namespace radbot_control;
+
+static const unsigned char kNoInformation = 255;
+
+static double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// The merge as originally written, index recomputed for every cell.
+static void reference(const std::vector<unsigned char>& layer, std::vector<unsigned char>& master, int size,
+                      bool use_max)
+{
+  for (int j = 0; j < size; j++)
+  {
+    for (int i = 0; i < size; i++)
+    {
+      int index = j * size + i;
+      if (layer[index] == kNoInformation)
+        continue;
+      unsigned char& old = master[j * size + i];
+      if (!use_max || old == kNoInformation || old < layer[index])
+        old = layer[index];
+    }
+  }
+}
+
+static void rows(const std::vector<unsigned char>& layer, std::vector<unsigned char>& master, int size, bool use_max)
+{
+  for (int j = 0; j < size; j++)
+  {
+    if (use_max)
+      maxRow(&layer[j * size], &master[j * size], size, kNoInformation);
+    else
+      overwriteRow(&layer[j * size], &master[j * size], size, kNoInformation);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  int size = argc > 1 ? atoi(argv[1]) : 4000;
+  int repeats = argc > 2 ? atoi(argv[2]) : 10;
+
+  //a layer with unknown patches over a master with obstacles and unknown
+  std::vector<unsigned char> layer(size * size), master(size * size);
+  srand(1);
+  for (int i = 0; i < size * size; i++)
+  {
+    layer[i] = rand() % 8 == 0 ? kNoInformation : rand() % 254;
+    master[i] = rand() % 16 == 0 ? kNoInformation : rand() % 255;
+  }
+
+  printf("%d x %d grid, %d repeats\n", size, size, repeats);
+  for (int use_max = 0; use_max <= 1; use_max++)
+  {
+    std::vector<unsigned char> expect(master), got(master);
+    double t0 = now();
+    for (int r = 0; r < repeats; r++)
+    {
+      expect = master;
+      reference(layer, expect, size, use_max);
+    }
+    double t1 = now();
+    for (int r = 0; r < repeats; r++)
+    {
+      got = master;
+      rows(layer, got, size, use_max);
+    }
+    double t2 = now();
+    //time the copies of master alone so they can be taken out
+    for (int r = 0; r < repeats; r++)
+      got = master;
+    double t3 = now();
+    rows(layer, got, size, use_max);
+    double copy = (t3 - t2) / repeats;
+    printf("%-9s per cell %8.2f ms  rows %8.2f ms  %s\n", use_max ? "max" : "overwrite",
+           ((t1 - t0) / repeats - copy) * 1e3, ((t2 - t1) / repeats - copy) * 1e3,
+           got == expect ? "match" : "MISMATCH");
+    if (got != expect)
+      return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * test_cost_merge.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  The row merges against costmap_2d's own CostmapLayer merges, over
+ *  windows whose widths are not a multiple of the vector width.
+ */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <costmap_2d/costmap_layer.h>
+#include "radbot_control/cost_merge.h"
+
+using costmap_2d::NO_INFORMATION;
+
+// Exposes the protected CostmapLayer merges.
+class referenceLayer : public costmap_2d::CostmapLayer
+{
+public:
+  referenceLayer(unsigned int size)
+  {
+    enabled_ = true;
+    resizeMap(size, size, 0.05, 0, 0);
+  }
+  void merge(costmap_2d::Costmap2D& master, int min_i, int min_j, int max_i, int max_j, bool use_max)
+  {
+    if (use_max)
+      updateWithMax(master, min_i, min_j, max_i, max_j);
+    else
+      updateWithOverwrite(master, min_i, min_j, max_i, max_j);
+  }
+};
+
+static const unsigned int kSize = 101;
+
+// Random costs with unknown patches, and the values either side of the
+// comparisons.
+static void fill(unsigned char* cells, unsigned int n, int unknown_every)
+{
+  static const unsigned char edge[] = { 0, 1, 127, 128, 253, 254 };
+  for (unsigned int k = 0; k < n; k++)
+  {
+    int r = rand();
+    if (r % unknown_every == 0)
+      cells[k] = NO_INFORMATION;
+    else if (r % 5 == 0)
+      cells[k] = edge[(r / 5) % 6];
+    else
+      cells[k] = r % 255;
+  }
+}
+
+static void expectMatch(bool use_max)
+{
+  srand(use_max ? 7 : 3);
+  const int windows[][4] = { { 0, 0, kSize, kSize }, { 3, 5, 20, 40 }, { 17, 1, 18, 100 }, { 50, 50, 67, 51 } };
+  for (int w = 0; w < 4; w++)
+  {
+    referenceLayer layer(kSize);
+    costmap_2d::Costmap2D expect(kSize, kSize, 0.05, 0, 0), got(kSize, kSize, 0.05, 0, 0);
+    fill(layer.getCharMap(), kSize * kSize, 8);
+    fill(expect.getCharMap(), kSize * kSize, 16);
+    memcpy(got.getCharMap(), expect.getCharMap(), kSize * kSize);
+
+    int min_i = windows[w][0], min_j = windows[w][1], max_i = windows[w][2], max_j = windows[w][3];
+    layer.merge(expect, min_i, min_j, max_i, max_j, use_max);
+    for (int j = min_j; j < max_j; j++)
+    {
+      const unsigned char* src = layer.getCharMap() + j * kSize + min_i;
+      unsigned char* dst = got.getCharMap() + j * kSize + min_i;
+      if (use_max)
+        radbot_control::maxRow(src, dst, max_i - min_i, NO_INFORMATION);
+      else
+        radbot_control::overwriteRow(src, dst, max_i - min_i, NO_INFORMATION);
+    }
+    for (unsigned int k = 0; k < kSize * kSize; k++)
+      ASSERT_EQ(expect.getCharMap()[k], got.getCharMap()[k]) << "window " << w << " cell " << k;
+  }
+}
+
+TEST(CostMerge, OverwriteMatchesCostmapLayer)
+{
+  expectMatch(false);
+}
+
+TEST(CostMerge, MaxMatchesCostmapLayer)
+{
+  expectMatch(true);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
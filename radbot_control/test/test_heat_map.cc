@@ -0,0 +1,262 @@
+/*
+ * test_heat_map.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  The heatmap against inverse distance weighting worked out directly, and
+ *  its independence from the order and batching of measurements. Then the
+ *  tiles allocated for measurements whose square ends on a tile edge or is
+ *  cut by the map edge.
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "radbot_control/heat_map.h"
+
+using radbot_control::HeatMap;
+
+static const unsigned char kNoInformation = 255;
+static const unsigned int kSize = 200;
+static const double kResolution = 0.1;
+static const double kOriginX = -3, kOriginY = -7;
+static const double kPower = 2;
+
+struct measurement
+{
+  double x, y;
+  int cost;
+};
+
+static void setUp(HeatMap& heat)
+{
+  heat.resize(kSize, kSize, kResolution, kOriginX, kOriginY);
+  heat.setShepardPower(kPower);
+}
+
+static void resolve(HeatMap& heat)
+{
+  int min_i, min_j, max_i, max_j;
+  heat.resolveDirty(&min_i, &min_j, &max_i, &max_j);
+}
+
+// Measurements on cell corners, where the painted distance to a cell
+// centre is exact, some close enough to overlap.
+static std::vector<measurement> survey()
+{
+  std::vector<measurement> all;
+  unsigned int seed = 6;
+  for (int k = 0; k < 40; k++)
+  {
+    measurement m;
+    m.x = kOriginX + (20 + rand_r(&seed) % 160) * kResolution;
+    m.y = kOriginY + (20 + rand_r(&seed) % 160) * kResolution;
+    m.cost = rand_r(&seed) % 255;
+    all.push_back(m);
+  }
+  return all;
+}
+
+TEST(HeatMap, OrderDoesNotMatter)
+{
+  std::vector<measurement> all = survey();
+  HeatMap forward(kNoInformation), backward(kNoInformation), batched(kNoInformation);
+  setUp(forward);
+  setUp(backward);
+  setUp(batched);
+  for (size_t k = 0; k < all.size(); k++)
+  {
+    forward.paint(all[k].x, all[k].y, all[k].cost);
+    backward.paint(all[all.size() - 1 - k].x, all[all.size() - 1 - k].y, all[all.size() - 1 - k].cost);
+    //resolved every few measurements, as the update thread would
+    batched.paint(all[(k * 7) % all.size()].x, all[(k * 7) % all.size()].y, all[(k * 7) % all.size()].cost);
+    if (k % 5 == 0)
+      resolve(batched);
+  }
+  resolve(forward);
+  resolve(backward);
+  resolve(batched);
+  int known = 0;
+  for (unsigned int j = 0; j < kSize; j++)
+  {
+    for (unsigned int i = 0; i < kSize; i++)
+    {
+      unsigned char cost = forward.getCost(i, j);
+      known += cost != kNoInformation;
+      ASSERT_EQ(cost, backward.getCost(i, j)) << "cell " << i << ", " << j;
+      ASSERT_EQ(cost, batched.getCost(i, j)) << "cell " << i << ", " << j;
+    }
+  }
+  EXPECT_GT(known, 0);
+}
+
+// Every cell within reach is sum(w * cost) / sum(w) over the measurements
+// within 5 m of it, w = d^-power.
+TEST(HeatMap, InverseDistanceWeighted)
+{
+  std::vector<measurement> all = survey();
+  HeatMap heat(kNoInformation);
+  setUp(heat);
+  for (size_t k = 0; k < all.size(); k++)
+    heat.paint(all[k].x, all[k].y, all[k].cost);
+  resolve(heat);
+  for (unsigned int j = 0; j < kSize; j += 3)
+  {
+    for (unsigned int i = 0; i < kSize; i += 3)
+    {
+      double sum_wv = 0, sum_w = 0;
+      for (size_t k = 0; k < all.size(); k++)
+      {
+        int di = i - (int)floor((all[k].x - kOriginX) / kResolution + 0.5);
+        int dj = j - (int)floor((all[k].y - kOriginY) / kResolution + 0.5);
+        if (abs(di) > 50 || abs(dj) > 50)
+          continue;
+        double w = pow(hypot(di + 0.5, dj + 0.5) * kResolution, -kPower);
+        sum_wv += w * all[k].cost;
+        sum_w += w;
+      }
+      if (sum_w == 0)
+      {
+        EXPECT_EQ(kNoInformation, heat.getCost(i, j));
+        continue;
+      }
+      EXPECT_NEAR(sum_wv / sum_w, heat.getCost(i, j), 0.5 + 1e-9) << "cell " << i << ", " << j;
+    }
+  }
+}
+
+// A lone cost is the cost of every cell it reaches, however far.
+TEST(HeatMap, SameCostEverywhere)
+{
+  HeatMap heat(kNoInformation);
+  setUp(heat);
+  resolve(heat); //resize dirties the whole map
+  heat.paint(kOriginX + 10, kOriginY + 10, 77);
+  heat.paint(kOriginX + 10.5, kOriginY + 9.2, 77);
+  int min_i, min_j, max_i, max_j;
+  ASSERT_TRUE(heat.resolveDirty(&min_i, &min_j, &max_i, &max_j));
+  EXPECT_FALSE(heat.resolveDirty(&min_i, &min_j, &max_i, &max_j));
+  EXPECT_EQ(50, min_i);
+  EXPECT_EQ(42, min_j);
+  EXPECT_EQ(156, max_i);
+  EXPECT_EQ(151, max_j);
+  for (int j = 0; j < (int)kSize; j++)
+  {
+    for (int i = 0; i < (int)kSize; i++)
+    {
+      bool inside = i >= min_i && i < max_i && j >= min_j && j < max_j;
+      unsigned char cost = heat.getCost(i, j);
+      if (cost != kNoInformation)
+      {
+        ASSERT_EQ(77, cost) << "cell " << i << ", " << j;
+      }
+      if (!inside)
+      {
+        ASSERT_EQ(kNoInformation, cost) << "cell " << i << ", " << j;
+      }
+    }
+  }
+  //the corners of the painted square are reached
+  EXPECT_EQ(77, heat.getCost(50, 50));
+  EXPECT_EQ(77, heat.getCost(155, 142));
+}
+
+// 150 x 130 cells at 0.1 m, 3 x 3 tiles with the last row and column
+// partial. A measurement reaches 50 cells either side of its cell.
+static const unsigned int kTilesX = 150, kTilesY = 130;
+
+static size_t tilesFor(double x, double y)
+{
+  HeatMap heat(kNoInformation);
+  heat.resize(kTilesX, kTilesY, kResolution, 0, 0);
+  heat.paint(x, y, 100);
+  return heat.getTileCount();
+}
+
+TEST(HeatMap, TilesAtTheEdges)
+{
+  const int tile_size = HeatMap::kTileSize;
+  ASSERT_EQ(64, tile_size);
+  //cell 13 reaches cells 0 to 63, cell 14 one past the first tile
+  EXPECT_EQ(1u, tilesFor(1.3, 1.3));
+  EXPECT_EQ(2u, tilesFor(1.4, 1.3));
+  EXPECT_EQ(2u, tilesFor(1.3, 1.4));
+  EXPECT_EQ(4u, tilesFor(1.4, 1.4));
+  //cell 178 starts on the last tile, 177 one cell before it
+  EXPECT_EQ(1u, tilesFor(17.8, 1.3));
+  EXPECT_EQ(2u, tilesFor(17.7, 1.3));
+  //the far corner, cut by both map edges
+  EXPECT_EQ(4u, tilesFor(14.9, 12.9));
+  //one cell of the square left inside the map, then none
+  EXPECT_EQ(1u, tilesFor(19.9, 1.3));
+  EXPECT_EQ(0u, tilesFor(20.0, 1.3));
+  EXPECT_EQ(0u, tilesFor(1.3, 18.1));
+  EXPECT_EQ(1u, tilesFor(-4.9, -4.9));
+  EXPECT_EQ(0u, tilesFor(-5.1, 1.3));
+}
+
+// Memory grows by one tile at a time and clear() returns it, a cleared
+// map reads as unknown everywhere and can be painted again.
+TEST(HeatMap, ClearFreesTheTiles)
+{
+  HeatMap heat(kNoInformation);
+  heat.resize(kTilesX, kTilesY, kResolution, 0, 0);
+  size_t empty = heat.memoryUsed();
+  heat.paint(1.3, 1.3, 100);
+  size_t tile = heat.memoryUsed() - empty;
+  EXPECT_GE(tile, 2 * 8 * 64 * 64u);
+  heat.paint(14.9, 12.9, 100);
+  EXPECT_EQ(5u, heat.getTileCount());
+  EXPECT_EQ(empty + 5 * tile, heat.memoryUsed());
+  heat.clear();
+  EXPECT_EQ(0u, heat.getTileCount());
+  EXPECT_EQ(empty, heat.memoryUsed());
+  resolve(heat);
+  EXPECT_EQ(kNoInformation, heat.getCost(10, 10));
+  EXPECT_EQ(kNoInformation, heat.getCost(149, 129));
+  heat.paint(14.9, 12.9, 100);
+  resolve(heat);
+  EXPECT_EQ(4u, heat.getTileCount());
+  EXPECT_EQ(100, heat.getCost(149, 129));
+  //resizing drops the tiles as well
+  heat.resize(kTilesX, kTilesY, kResolution, 0, 0);
+  EXPECT_EQ(0u, heat.getTileCount());
+}
+
+// The merge writes the painted square and nothing else, across tile
+// edges and into the partial last tiles.
+TEST(HeatMap, MergeCoversThePaintedCells)
+{
+  HeatMap heat(kNoInformation);
+  heat.resize(kTilesX, kTilesY, kResolution, 0, 0);
+  heat.paint(14.9, 12.9, 200); //cells 99-149 by 79-129
+  heat.paint(1.4, 1.3, 200);   //cells 0-64 by 0-63
+  resolve(heat);
+  for (int use_max = 0; use_max <= 1; use_max++)
+  {
+    std::vector<unsigned char> master(kTilesX * kTilesY, 7);
+    master[10 * kTilesX + 10] = 230;
+    //a window ending inside the painted squares and the last tile
+    heat.merge(&master[0], 5, 3, 140, 120, use_max);
+    for (int j = 0; j < (int)kTilesY; j++)
+    {
+      for (int i = 0; i < (int)kTilesX; i++)
+      {
+        bool window = i >= 5 && i < 140 && j >= 3 && j < 120;
+        bool painted = (i <= 64 && j <= 63) || (i >= 99 && j >= 79);
+        unsigned char expect = window && painted ? 200 : 7;
+        if (i == 10 && j == 10)
+          expect = use_max ? 230 : 200;
+        ASSERT_EQ(expect, master[j * kTilesX + i]) << "cell " << i << ", " << j << (use_max ? " max" : "");
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,81 @@
+/*
+ * aligned.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_ALIGNED_H_
+#define INCLUDE_RADBOT_PROCESSOR_ALIGNED_H_
+
+#include <stdlib.h>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Minimal allocator so std::vector storage starts on an Align byte
+// boundary (32 covers a full AVX register).
+template<typename T, std::size_t Align = 32>
+class aligned_allocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef aligned_allocator<U, Align> other;
+    };
+
+    aligned_allocator() {
+    }
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, Align>&) {
+    }
+
+    pointer address(reference x) const {
+        return &x;
+    }
+    const_pointer address(const_reference x) const {
+        return &x;
+    }
+    pointer allocate(size_type n, const void* = 0) {
+        void *p = 0;
+        if (posix_memalign(&p, Align, n > 0 ? n * sizeof(T) : Align))
+            throw std::bad_alloc();
+        return static_cast<pointer>(p);
+    }
+    void deallocate(pointer p, size_type) {
+        free(p);
+    }
+    size_type max_size() const {
+        return size_type(-1) / sizeof(T);
+    }
+    void construct(pointer p, const T& val) {
+        new (p) T(val);
+    }
+    void destroy(pointer p) {
+        p->~T();
+    }
+};
+
+template<typename T, typename U, std::size_t Align>
+inline bool operator==(const aligned_allocator<T, Align>&,
+                       const aligned_allocator<U, Align>&) {
+    return true;
+}
+template<typename T, typename U, std::size_t Align>
+inline bool operator!=(const aligned_allocator<T, Align>&,
+                       const aligned_allocator<U, Align>&) {
+    return false;
+}
+
+typedef std::vector<double, aligned_allocator<double> > aligned_vector;
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_ALIGNED_H_ */
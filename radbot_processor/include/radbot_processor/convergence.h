@@ -0,0 +1,137 @@
+/*
+ * convergence.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_CONVERGENCE_H_
+#define INCLUDE_RADBOT_PROCESSOR_CONVERGENCE_H_
+
+#include <math.h>
+#include <vector>
+
+// Tracks the k particles with the lowest personal best cost and tests
+// whether they have all collapsed onto the global best.
+//
+// Personal bests only ever go down, so the set is kept in a max heap
+// keyed on pmin: an improving member sifts toward the leaves and an
+// improving outsider only has to beat the root. Each update is O(log k).
+class convergence
+{
+public:
+    convergence() :
+            pmin_(0), k_(0) {
+    }
+
+    // (Re)builds the top k set from every particle.
+    void reset(const std::vector<double> &pmin, int k) {
+        pmin_ = &pmin;
+        k_ = k < 1 ? 1 : (k > (int) pmin.size() ? pmin.size() : k);
+        heap_.clear();
+        heap_.reserve(k_);
+        pos_.assign(pmin.size(), -1);
+        for (size_t i = 0; i < pmin.size(); i++)
+            update(i);
+    }
+
+    // Call after pmin[particle] went down.
+    void update(int particle) {
+        int at = pos_[particle];
+        if (at >= 0) {
+            siftDown(at);
+        }
+        else if (heap_.size() < (size_t) k_) {
+            heap_.push_back(particle);
+            pos_[particle] = heap_.size() - 1;
+            siftUp(heap_.size() - 1);
+        }
+        else if (cost(particle) < cost(heap_[0])) {
+            pos_[heap_[0]] = -1;
+            heap_[0] = particle;
+            pos_[particle] = 0;
+            siftDown(0);
+        }
+    }
+
+    // True when every tracked personal best lies within tol of gbest,
+    // with each dimension divided by the width of its search bounds.
+    // Sources are interchangeable, so each source of gbest is matched
+    // (greedily) to the nearest unmatched source of the particle, stride
+    // values apart.
+    bool converged(const std::vector<double> &pbest,
+                   const std::vector<double> &gbest,
+                   const std::vector<double> &scale, int stride,
+                   double tol) const {
+        int n_vars = gbest.size();
+        int sources = n_vars / stride;
+        for (size_t h = 0; h < heap_.size(); h++) {
+            const double *row = &pbest[(size_t) heap_[h] * n_vars];
+            unsigned long long used = 0;
+            double result = 0;
+            for (int g = 0; g < sources; g++) {
+                double nearest = -1;
+                int match = 0;
+                for (int p = 0; p < sources; p++) {
+                    if (used & (1ULL << p))
+                        continue;
+                    double dist = 0;
+                    for (int x = 0; x < stride; x++) {
+                        double d = (row[p * stride + x] - gbest[g * stride + x])
+                                * scale[x];
+                        dist += d * d;
+                    }
+                    if (nearest < 0 || dist < nearest) {
+                        nearest = dist;
+                        match = p;
+                    }
+                }
+                used |= 1ULL << match;
+                result += nearest;
+            }
+            if (result > tol * tol)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    double cost(int particle) const {
+        return (*pmin_)[particle];
+    }
+    void swap(int a, int b) {
+        std::swap(heap_[a], heap_[b]);
+        pos_[heap_[a]] = a;
+        pos_[heap_[b]] = b;
+    }
+    void siftUp(int at) {
+        while (at > 0) {
+            int parent = (at - 1) / 2;
+            if (cost(heap_[parent]) >= cost(heap_[at]))
+                break;
+            swap(parent, at);
+            at = parent;
+        }
+    }
+    void siftDown(int at) {
+        int n = heap_.size();
+        while (true) {
+            int largest = at;
+            int l = 2 * at + 1, r = 2 * at + 2;
+            if (l < n && cost(heap_[l]) > cost(heap_[largest]))
+                largest = l;
+            if (r < n && cost(heap_[r]) > cost(heap_[largest]))
+                largest = r;
+            if (largest == at)
+                break;
+            swap(at, largest);
+            at = largest;
+        }
+    }
+
+    const std::vector<double> *pmin_;
+    int k_;
+    std::vector<int> heap_, pos_;
+};
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_CONVERGENCE_H_ */
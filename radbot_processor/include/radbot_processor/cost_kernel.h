@@ -0,0 +1,37 @@
+/*
+ * cost_kernel.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_COST_KERNEL_H_
+#define INCLUDE_RADBOT_PROCESSOR_COST_KERNEL_H_
+
+// Inverse square kernels used by costfn. Observations are passed as
+// structure of arrays (ox, oy, oc, ow), predict holds num_src (x, y,
+// strength) triples. Each returns the weighted sum of squared residuals
+// over all readings.
+// The arrays need not be aligned, costfn passes offsets into them.
+//
+// This header is also included by the translation unit built with AVX2
+// flags, so it must stay free of inline code.
+
+typedef double (*cost_kernel_fn)(const double *ox, const double *oy,
+                                 const double *oc, const double *ow,
+                                 int num_obs, const double *predict,
+                                 int num_src);
+
+double
+costKernelScalar(const double *ox, const double *oy, const double *oc,
+                 const double *ow, int num_obs, const double *predict,
+                 int num_src);
+
+#ifdef RADBOT_HAVE_AVX2
+double
+costKernelAvx2(const double *ox, const double *oy, const double *oc,
+               const double *ow, int num_obs, const double *predict,
+               int num_src);
+#endif
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_COST_KERNEL_H_ */
@@ -8,55 +8,156 @@
 #ifndef INCLUDE_RADBOT_PROCESSOR_COSTFN_H_
 #define INCLUDE_RADBOT_PROCESSOR_COSTFN_H_
 
-#include "ros/ros.h"
 #include "radbot_processor/util.h"
+#include "radbot_processor/log.h"
+#include "radbot_processor/aligned.h"
+#include "radbot_processor/cost_kernel.h"
+#include "radbot_processor/grid_table.h"
+#include "radbot_processor/linalg.h"
 #include <math.h>
 #include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
 
 class costfn
 {
 public:
+    enum kernel
+    {
+        kAuto, kScalar, kAvx2
+    };
+    enum backend
+    {
+        kAnalytic, kGrid
+    };
+    static const int kMaxSources = 16;
+
     inline costfn(std::vector<sample> readings) :
-            obs_(readings) {
+            wsum_(0), bin_res_(0), readings_(0), backend_(kAnalytic) {
+        setKernel(kAuto);
+        for (size_t i = 0; i < readings.size(); i++)
+            addSample(readings[i]);
     }
-    inline costfn() {
+    inline costfn() :
+            wsum_(0), bin_res_(0), readings_(0), backend_(kAnalytic) {
+        setKernel(kAuto);
     }
     //space for costfn with map for raytracing.
 
-    inline double operator()(std::vector<double> predict) {
-        ROS_ASSERT(obs_.size() > 0);
-        int num_src = predict.size() / 3;
-        int num_obs = obs_.size();
-        double cost = 0;
+    inline double operator()(const std::vector<double> &predict) const {
+        return (*this)(&predict[0], predict.size() / 3);
+    }
+
+    // predict holds num_src (x, y, strength) triples. Allocation free so
+    // it can be called from the pso workers once per particle.
+    inline double operator()(const double *predict, int num_src) const {
+        double out;
+        score(predict, 1, 0, num_src, &out);
+        return out;
+    }
 
-        std::vector<double> intAt(obs_.size(), 0);
-        double radius = 0;
+    // operator() without the grid tables, so costs from different backends
+    // can be compared.
+    double
+    analytic(const double *predict, int num_src) const;
 
-        for (int i = 0; i < num_obs; i++) { //for each reading
-            for (int j = 0; j < num_src; j++) { //for each src
-                radius = sqrt(
-                        pow(obs_[i].x - predict[j * 3], 2)
-                                + pow(obs_[i].y - predict[j * 3 + 1], 2));
-                intAt[i] += predict[j * 3 + 2] / pow(radius, 2);
-            }
-        }
-        for (int i = 0; i < num_obs; i++) {
-            cost += pow(intAt[i] - obs_[i].counts, 2);
-        }
-        return pow(cost / num_obs, 0.5);
+    // Scores n_particles candidates laid out stride doubles apart into out.
+    void
+    score(const double *particles, int n_particles, int stride, int num_src,
+          double *out) const;
+
+    // Closed form strengths: particles hold num_src (x, y) pairs and the
+    // best non-negative strengths for those positions are solved exactly
+    // (the prediction is linear in them). Scores like score().
+    void
+    scorePositions(const double *particles, int n_particles, int stride,
+                   int num_src, double *out) const;
+    // Same for one candidate, also writes the strengths if not NULL.
+    double
+    solveStrengths(const double *pos, int num_src, double *strengths) const;
+
+    // Picks the inner loop, kAuto uses AVX2 when the cpu has it. Returns
+    // false if the requested kernel is not available.
+    bool
+    setKernel(kernel k);
+    kernel getKernel() const {
+        return kernel_;
     }
 
-    inline void addSample(sample samp) {
-        obs_.push_back(samp);
+    // kGrid scores against per reading lookup tables with the given cell
+    // size (m), using at most budget_bytes for them. Copies of this costfn
+    // share the tables.
+    void
+    setBackend(backend b, double resolution = 0.05,
+               size_t budget_bytes = 256 << 20);
+    backend getBackend() const {
+        return backend_;
+    }
+    const boost::shared_ptr<gridTable>& getGrid() const {
+        return grid_;
     }
+
+    // Called by the solver before scoring with its search bounds, builds
+    // any tables the backend is missing. Const as the tables are shared by
+    // every copy, see gridTable::prepare() for when it may be called.
+    void
+    prepare(const sample &min, const sample &max) const;
+
+    // Merges readings into square bins of the given size (m) so the number
+    // of observations, and the cost of an evaluation, is bounded by the
+    // surveyed area rather than the survey time. A bin holds the weight
+    // averaged position and counts of its readings and their total weight.
+    // 0 keeps every reading as its own observation. Existing observations
+    // are re-binned.
+    void
+    setBinning(double resolution);
+    double getBinning() const {
+        return bin_res_;
+    }
+
+    void
+    addSample(const sample &samp);
     inline void clearAll() {
         obs_.clear();
+        x_.clear();
+        y_.clear();
+        c_.clear();
+        w_.clear();
+        wsum_ = 0;
+        bins_.clear();
+        readings_ = 0;
+    }
+    // Readings added since the last clearAll(), getObs().size() is the
+    // number of observations they were compacted into.
+    inline unsigned long getReadings() const {
+        return readings_;
+    }
+    // Sum of the sample weights, the RMS costs are normalised by it.
+    inline double getWeight() const {
+        return wsum_;
     }
-    inline std::vector<sample> getObs() {
+    // Kish effective number of observations, (sum w)^2 / sum w^2: the
+    // observation count when the weights are equal, fewer when a few
+    // observations dominate the weighted RMS. A bin's readings share one
+    // residual, so binning lowers it.
+    double
+    getEffectiveObs() const;
+    inline const std::vector<sample>& getObs() const {
         return obs_;
     }
 private:
     std::vector<sample> obs_;
+    //structure of arrays copy of obs_ for the kernels
+    aligned_vector x_, y_, c_, w_;
+    double wsum_;
+    double bin_res_;
+    boost::unordered_map<boost::uint64_t, int> bins_; //cell -> obs_ index
+    unsigned long readings_;
+    kernel kernel_;
+    cost_kernel_fn kernel_fn_;
+    backend backend_;
+    boost::shared_ptr<gridTable> grid_;
 
 };
 
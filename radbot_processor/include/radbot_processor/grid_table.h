@@ -0,0 +1,88 @@
+/*
+ * grid_table.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_GRID_TABLE_H_
+#define INCLUDE_RADBOT_PROCESSOR_GRID_TABLE_H_
+
+#include <deque>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "radbot_processor/util.h"
+
+// Per observation inverse square response tables over a grid covering the
+// search bounds. Scoring a candidate becomes one gather and multiply-add
+// per (observation, source) pair, with the source snapped to the nearest
+// grid cell.
+//
+// Snapping moves a source by up to resolution / sqrt(2), which changes
+// 1/r^2 without bound close to the reading. Cells within kNearCells of a
+// reading are left out of its table and those pairs are scored exactly,
+// so every tabled rate is within kMaxRateError of the exact one, for a
+// source inside the bounds.
+//
+// Tables are built lazily by prepare(), rebuilt for readings that moved
+// (binned observations drift as they absorb readings), extended when
+// readings are appended, and capped by a memory budget: readings past the
+// budget are left for the analytic kernel.
+class gridTable
+{
+public:
+    static const int kMaxSources = 16;
+    static const int kNearCells = 20;
+    // (1 + 1 / (sqrt(2) kNearCells))^2 - 1, plus float rounding
+    static const double kMaxRateError;
+
+    gridTable();
+
+    // Drops every table if the cell size or budget changed.
+    void
+    configure(double resolution, size_t budget_bytes);
+
+    // Makes the tables match the leading readings in ox/oy over the given
+    // bounds. Only tables whose reading moved are rebuilt. sumSquares() does
+    // not lock, so this must not change the tables while another solver is
+    // scoring: build them before the solvers fan out, their own calls then
+    // find nothing to do and return without writing.
+    void
+    prepare(const sample &min, const sample &max, const double *ox,
+            const double *oy, int num_obs);
+
+    // Number of readings (from the front) that have a table.
+    int size() const {
+        return tables_.size();
+    }
+
+    // Sum of squared residuals over the tabled readings, oc holds their
+    // counts.
+    double
+    sumSquares(const double *predict, int num_src, const double *oc,
+               const double *ow) const;
+
+    size_t memoryUsed() const {
+        return tables_.size() * cells() * sizeof(float);
+    }
+
+private:
+    size_t cells() const {
+        return (size_t) nx_ * ny_;
+    }
+    void
+    fillTable(int i, double x, double y);
+    bool
+    matches(const sample &min, const sample &max, const double *ox,
+            const double *oy, int num_obs) const;
+
+    boost::mutex mutex_;
+    double resolution_;
+    size_t budget_;
+    sample min_, max_;
+    int nx_, ny_;
+    std::deque<std::vector<float> > tables_;
+    std::vector<double> tx_, ty_; //reading each table was built for
+};
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_GRID_TABLE_H_ */
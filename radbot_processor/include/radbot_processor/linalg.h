@@ -0,0 +1,29 @@
+/*
+ * linalg.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_LINALG_H_
+#define INCLUDE_RADBOT_PROCESSOR_LINALG_H_
+
+// Small dense solvers for the per-candidate systems in costfn and the
+// refinement stage. Matrices are row major n x n, n is a handful of
+// sources so everything lives on the stack.
+
+static const int kMaxLinalg = 48;
+
+// Solves A x = b in place (b becomes x) for symmetric positive definite A,
+// A is overwritten by its Cholesky factor. Returns false if A is not
+// positive definite.
+bool
+choleskySolve(double *A, double *b, int n);
+
+// Non-negative least squares on the normal equations: minimises
+// x'Gx - 2x'b subject to x >= 0 (Lawson-Hanson active set). G is the
+// Gram matrix A'A and b is A'y. Returns x'Gx - 2x'b at the solution.
+double
+nnls(const double *G, const double *b, int n, double *x);
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_LINALG_H_ */
@@ -0,0 +1,53 @@
+/*
+ * log.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_LOG_H_
+#define INCLUDE_RADBOT_PROCESSOR_LOG_H_
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+
+// Logging for the estimator core, which is built without roscpp. Messages
+// go to stderr unless a handler is installed, the ROS node forwards them
+// to rosconsole.
+
+enum logLevel
+{
+    kLogDebug, kLogInfo, kLogWarn, kLogError
+};
+
+typedef void (*log_fn)(logLevel level, const std::string &msg);
+
+// NULL restores the stderr handler.
+void
+setLogHandler(log_fn handler);
+// Messages below level are dropped before they are formatted.
+void
+setLogLevel(logLevel level);
+bool
+logEnabled(logLevel level);
+void
+logMessage(logLevel level, const std::string &msg);
+
+#define RADBOT_LOG_STREAM(level, args) \
+    do { \
+        if (logEnabled(level)) { \
+            std::ostringstream radbot_log_ss; \
+            radbot_log_ss << args; \
+            logMessage(level, radbot_log_ss.str()); \
+        } \
+    } while (0)
+
+#define RADBOT_DEBUG_STREAM(args) RADBOT_LOG_STREAM(kLogDebug, args)
+#define RADBOT_INFO_STREAM(args) RADBOT_LOG_STREAM(kLogInfo, args)
+#define RADBOT_WARN_STREAM(args) RADBOT_LOG_STREAM(kLogWarn, args)
+#define RADBOT_ERROR_STREAM(args) RADBOT_LOG_STREAM(kLogError, args)
+
+#define RADBOT_ASSERT(cond) assert(cond)
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_LOG_H_ */
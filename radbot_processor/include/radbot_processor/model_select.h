@@ -0,0 +1,61 @@
+/*
+ * model_select.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_MODEL_SELECT_H_
+#define INCLUDE_RADBOT_PROCESSOR_MODEL_SELECT_H_
+
+#include <vector>
+#include "radbot_processor/costfn.h"
+#include "radbot_processor/pso.h"
+
+// Solver settings shared by every candidate source count.
+struct psoOptions
+{
+    psoOptions() :
+            particles(100), iterations(300), runs(3), threads(1), closed_form(
+                    true), refine(true), max_evals(0), deadline(0), seed(0) {
+    }
+    unsigned int particles, iterations;
+    int runs;
+    unsigned int threads; //total, also caps the concurrent solves
+    bool closed_form, refine;
+    unsigned long max_evals; //per solve, 0 for no limit
+    double deadline; //seconds, 0 for no limit
+    unsigned int seed; //shared by every solve, 0 for a time based seed
+    pso::progress_fn progress; //called from every solve thread concurrently
+};
+
+struct modelFit
+{
+    std::vector<double> params;
+    double cost; //RMS residual
+    double score; //information criterion, lower is better
+};
+
+enum modelCriterion
+{
+    kBic, kAic
+};
+
+// Information criterion of a fit with num_params free parameters and the
+// given weighted RMS residual over num_obs observations (Gaussian
+// residuals), see costfn::getEffectiveObs().
+double
+modelScore(modelCriterion criterion, double rms, double num_obs,
+           int num_params);
+
+// Solves k = 1..max_src sources (at most costfn::kMaxSources), up to
+// options.threads of them concurrently with one thread per k, and scores
+// each fit. fits[k - 1] holds the fit for k sources. Returns the k with the
+// lowest score. Free strength solves share the cost's grid tables, they are
+// built once before the threads start.
+int
+selectSources(const costfn &cost, const sample &min, const sample &max,
+              int max_src, const psoOptions &options,
+              modelCriterion criterion, std::vector<modelFit> &fits);
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_MODEL_SELECT_H_ */
@@ -0,0 +1,74 @@
+/*
+ * philox.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_PHILOX_H_
+#define INCLUDE_RADBOT_PROCESSOR_PHILOX_H_
+
+#include <boost/cstdint.hpp>
+
+// Philox4x32-10 counter based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3", SC11). Every 128 bit counter maps to four
+// independent 32 bit words under a 64 bit key, so any draw can be
+// recomputed from its coordinates alone: no state is carried between
+// calls, threads never share a stream and results do not depend on how
+// the work is split.
+class philox
+{
+public:
+    philox(boost::uint32_t k0 = 0, boost::uint32_t k1 = 0) {
+        setKey(k0, k1);
+    }
+    void setKey(boost::uint32_t k0, boost::uint32_t k1) {
+        key_[0] = k0;
+        key_[1] = k1;
+    }
+
+    // The four words for counter ctr.
+    void block(const boost::uint32_t ctr[4], boost::uint32_t out[4]) const {
+        boost::uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+        boost::uint32_t k0 = key_[0], k1 = key_[1];
+        for (int r = 0; r < 10; r++) {
+            boost::uint64_t p0 = (boost::uint64_t) kM0 * c0;
+            boost::uint64_t p1 = (boost::uint64_t) kM1 * c2;
+            boost::uint32_t n0 = (boost::uint32_t) (p1 >> 32) ^ c1 ^ k0;
+            boost::uint32_t n2 = (boost::uint32_t) (p0 >> 32) ^ c3 ^ k1;
+            c1 = (boost::uint32_t) p1;
+            c3 = (boost::uint32_t) p0;
+            c0 = n0;
+            c2 = n2;
+            k0 += kW0;
+            k1 += kW1;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    // n uniforms in (0, 1) for the draw identified by (a, b, c), taken
+    // from consecutive blocks with ctr = (a, b, c, block index). The
+    // blocks are independent, so the loop is free to vectorise.
+    void uniforms(boost::uint32_t a, boost::uint32_t b, boost::uint32_t c,
+                  double *out, int n) const {
+        boost::uint32_t ctr[4] = { a, b, c, 0 };
+        boost::uint32_t words[4];
+        for (int i = 0; i < n; i += 4, ctr[3]++) {
+            block(ctr, words);
+            for (int j = 0; j < 4 && i + j < n; j++)
+                out[i + j] = (words[j] + 0.5) * (1.0 / 4294967296.0);
+        }
+    }
+
+private:
+    static const boost::uint32_t kM0 = 0xD2511F53;
+    static const boost::uint32_t kM1 = 0xCD9E8D57;
+    static const boost::uint32_t kW0 = 0x9E3779B9;
+    static const boost::uint32_t kW1 = 0xBB67AE85;
+    boost::uint32_t key_[2];
+};
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_PHILOX_H_ */
@@ -14,16 +14,30 @@
 #include <algorithm>
 #include "radbot_processor/util.h"
 #include "radbot_processor/costfn.h"
-#include <boost/random/mersenne_twister.hpp>
-#include <boost/random/uniform_real_distribution.hpp>
-#include "ros/ros.h"
+#include "radbot_processor/convergence.h"
+#include "radbot_processor/refine.h"
+#include "radbot_processor/philox.h"
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/function.hpp>
+#include "radbot_processor/log.h"
+
+// Solver state handed to the progress hook once per iteration.
+struct psoProgress
+{
+    int run; //restart index, 0 for the first (or warm) run
+    int iteration; //-1 right after the swarm was (re)scored
+    unsigned long evaluations;
+    double cost; //gbest cost so far
+};
 
 class pso
 {
 
 public:
     pso(const costfn& cost_fn, sample mins, sample maxs, unsigned int particles,
-        unsigned int iter, unsigned int sources);
+        unsigned int iter, unsigned int sources, unsigned int threads = 1);
     ~pso();
     std::vector<double>
     run();
@@ -31,18 +45,28 @@ public:
         cost_ = cost_fn;
     }
 
+    // The setters below only drop the kept swarm when something changed,
+    // otherwise the next run() continues from it.
     void setSources(unsigned int sources) {
+        if (sources == sources_ && gbest_.size() == stride_ * sources)
+            return;
         sources_ = sources;
-        n_vars_ = 3 * sources_;
+        n_vars_ = stride_ * sources_;
         gbest_.assign(n_vars_, 0);
         gmin_ = 100000000;
+        warm_ = false;
     }
 
+    // New bounds keep the swarm, the next run() clamps it into them. They
+    // mostly grow as the survey covers more ground.
     void setBounds(const sample &maxs, const sample &mins) {
         min_ = mins;
         max_ = maxs;
     }
     void setParticles(unsigned int particles) {
+        if (particles == n_particles_ && neigh_.size() == 4 * particles)
+            return;
+        warm_ = false;
         n_particles_ = particles;
         stop_top_ = 0.1 * particles;
         neigh_.assign(n_particles_ * 4, -1);
@@ -50,7 +74,7 @@ public:
         //Find neighbors
         int dim = floor(pow(n_particles_, .5));
         bool one_more = (n_particles_ % dim) > 0;
-        for (int i = 0; i < n_particles_; i++) {
+        for (unsigned int i = 0; i < n_particles_; i++) {
             int r = i / dim;
             int c = i % dim;
             if (r > 0)
@@ -66,37 +90,184 @@ public:
                     neigh_[ndx(i, 3, 4)] = ndx(r, c + 1, dim);
             }
         }
-        ROS_INFO_STREAM("PSO: Changed Particles.");
+        RADBOT_INFO_STREAM("PSO: Changed Particles.");
+    }
+
+    // Particles carry only source positions and the strengths are solved
+    // in closed form for each candidate (costfn::scorePositions), cutting
+    // the search from 3 to 2 dimensions per source.
+    void setClosedForm(bool closed_form) {
+        if (closed_form == closed_form_ && stride_ == (closed_form ? 2 : 3))
+            return;
+        closed_form_ = closed_form;
+        stride_ = closed_form_ ? 2 : 3;
+        n_vars_ = stride_ * sources_;
+        gbest_.assign(n_vars_, 0);
+        gmin_ = 100000000;
+        warm_ = false;
+    }
+    // Polish gbest with Levenberg-Marquardt (refine.h) after the swarm, so
+    // the swarm only has to find the right basin.
+    void setRefine(bool refine) {
+        refine_ = refine;
+    }
+    void setIterations(unsigned int iter) {
+        n_iter_ = iter;
+    }
+    // Restarts without improvement before a cold run() gives up.
+    void setRuns(int runs) {
+        total_runs_ = runs < 1 ? 1 : runs;
+    }
+    // Called once per iteration, returning false stops the solve and run()
+    // returns the best estimate found so far.
+    typedef boost::function<bool(const psoProgress&)> progress_fn;
+    void setProgress(const progress_fn &progress) {
+        progress_ = progress;
     }
+    // Stops run() after max_evals cost evaluations or deadline seconds of
+    // wall time, 0 for no limit. Checked once per iteration.
+    void setBudget(unsigned long max_evals, double deadline) {
+        max_evals_ = max_evals;
+        deadline_ = deadline;
+    }
+    // True if the last run() ended early on the budget or the hook.
+    bool wasStopped() {
+        return stopped_;
+    }
+    // gbest as (x, y, strength) per source, without refinement. Safe to
+    // call from the progress hook.
+    std::vector<double>
+    currentBest() const;
+    // Personal best of every particle, one row of particle values each
+    // ((x, y) per source with closed form). Safe to call from the
+    // progress hook.
+    const std::vector<double>& getPersonalBests() const {
+        return pbest_;
+    }
+
+    // Every random draw is a function of (seed, restart, iteration,
+    // particle), so a cold run is replayed exactly by reusing its seed,
+    // with any thread count. Warm runs keep the seed of the cold run they
+    // carry on from and also depend on every run in between, see
+    // wasWarm(). Defaults to the construction time.
+    void setSeed(unsigned int seed) {
+        seed_ = seed;
+    }
+    unsigned int getSeed() const {
+        return seed_;
+    }
+    // Cost function evaluations made by the last run().
+    unsigned long getEvaluations() {
+        return evals_;
+    }
+
+    //threads used to score the swarm, the calling thread counts as one.
+    void setThreads(unsigned int threads);
+    unsigned int getThreads() {
+        return n_threads_;
+    }
+    // Cost of the last run()'s result, scored analytically when it was
+    // refined.
     double getGMin() {
         return gmin_;
     }
+    // Forces the next run() to start from a fresh random swarm, with
+    // nothing left over from earlier runs: a cold run() depends only on
+    // the seed, the samples and the settings.
+    void reset() {
+        gbest_.assign(n_vars_, 0);
+        gmin_ = 100000000;
+        prevmin_ = 1000000;
+        warm_ = false;
+    }
+    // True if the last run() started from the swarm of the one before,
+    // its result cannot be replayed from getSeed() alone.
+    bool wasWarm() const {
+        return was_warm_;
+    }
+
+    // Share of the kept swarm scattered again by a warm run(), and the
+    // iterations it runs before the stop condition is checked.
+    static const double kReseed_;
+    static const unsigned int kWarmIter_ = 60;
 
 private:
+    enum phase
+    {
+        kScore, kRescore, kMove
+    };
+    bool
+    loop(unsigned int min_iter);
+    void
+    findBest(const std::vector<double> &swarm);
+    std::vector<double>
+    result();
+    bool
+    outOfBudget(int iteration);
+    void
+    dispatch(phase work);
+    void
+    workerLoop(unsigned int id);
+    void
+    step(unsigned int id);
+    void
+    stopWorkers();
+    void
+    clampRow(double *row) const;
     void
-    loop();
+    reseed();
 
-    static const double kC1_ = 1.49;
-    static const double kC2_ = 1.49;
-    static const double kW_ = 0.72;
-    static const double kStopVal_ = .02;
+    static const double kC1_;
+    static const double kC2_;
+    static const double kW_;
+    static const double kStopVal_;
     static const int kTotalRuns_ = 10;
+    static const boost::uint32_t kInitDraw_ = 0xFFFFFFFF;
+    int total_runs_;
+    bool refine_;
+    progress_fn progress_;
+    unsigned long max_evals_;
+    double deadline_, start_time_;
+    bool stopped_;
+    int run_index_;
     int stop_top_;
 
 
-    boost::random::mt19937 rng_;
-    boost::random::uniform_real_distribution<double> uniform_;
+    philox rng_; //keyed by (seed_, solve_)
+    unsigned int seed_;
+    unsigned int solve_; //run() calls since the swarm was last cold
+    int iteration_;
+
+    //worker pool, each worker owns a slice of the swarm and scratch space
+    //for its particles' random draws
+    unsigned int n_threads_;
+    std::vector<std::vector<double> > worker_draws_;
+    std::vector<boost::thread*> workers_;
+    boost::mutex pool_mutex_;
+    boost::condition_variable work_cv_, done_cv_;
+    unsigned int generation_, pending_;
+    bool shutdown_;
+    phase phase_;
 
     costfn cost_;
     sample min_, max_;
     unsigned int n_particles_, n_iter_, n_vars_, sources_;
 
-    std::vector<double> v_, particles_, pbest_, pmin_, gbest_;
+    std::vector<double> v_, particles_, pbest_, pmin_, gbest_, tmin_;
     double gmin_;
     double  prevmin_;
+    bool warm_; //swarm from the last run() is valid for these settings
+    bool was_warm_; //the last run() carried on from the one before
+    bool closed_form_;
+    unsigned int stride_; //particle values per source
+    unsigned long evals_;
     std::vector<int> neigh_;
+    convergence converge_;
+    std::vector<double> scale_; //1 / bounds width for each dimension
 
-#define GET_ROW(x, vect)(std::vector<double>(vect.begin()+x*n_vars_,vect.begin()+(x+1)*n_vars_))
+    const double* row(int r, const std::vector<double> &vect) const {
+        return &vect[ndx(r, 0)];
+    }
 
     size_t ndx(int r, int c) const {
         return c + n_vars_ * r;
@@ -106,22 +277,8 @@ private:
         return c + dim * r;
     }
 
-    bool sortFn(std::size_t i, std::size_t j) const {
-        return (pmin_[i] < pmin_[j]);
-    }
-};
-
-class sortClass
-{
-public:
-    sortClass(std::vector<double> a) {
-        vec = a;
-    }
-    bool operator()(std::size_t i, std::size_t j) {
-        return (vec[i] < vec[j]);
-    }
-private:
-    std::vector<double> vec;
+    void
+    updateScale();
 };
 
 #endif /* INCLUDE_RADBOT_PROCESSOR_PSO_H_ */
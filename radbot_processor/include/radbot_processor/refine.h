@@ -0,0 +1,23 @@
+/*
+ * refine.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_REFINE_H_
+#define INCLUDE_RADBOT_PROCESSOR_REFINE_H_
+
+#include <vector>
+#include "radbot_processor/costfn.h"
+
+// Levenberg-Marquardt polish of a swarm estimate. params holds
+// (x, y, strength) per source and is updated in place, kept inside the
+// search bounds. Uses the analytic Jacobian of the inverse square model
+// against the readings in cost. Returns the RMS cost of the result, which
+// is never worse than the starting point.
+double
+refine(const costfn &cost, std::vector<double> &params, const sample &min,
+       const sample &max, int max_iter = 50);
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_REFINE_H_ */
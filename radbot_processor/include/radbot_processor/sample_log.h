@@ -0,0 +1,103 @@
+/*
+ * sample_log.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+
+#ifndef INCLUDE_RADBOT_PROCESSOR_SAMPLE_LOG_H_
+#define INCLUDE_RADBOT_PROCESSOR_SAMPLE_LOG_H_
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "radbot_processor/util.h"
+
+// Append-only binary log of observations, so a survey outlives the node.
+//
+// The file is a fixed header followed by fixed size records, each holding
+// one sample, its index and a CRC32 over both. It is memory mapped shared:
+// appending is a copy into the page cache, which the kernel keeps if the
+// process dies, and the mapping grows by doubling. open() keeps the
+// records up to the first one that fails its check, so a write torn by a
+// power cut costs that record only. Records are host endian.
+class sampleLog
+{
+public:
+    sampleLog();
+    ~sampleLog();
+
+    // Opens the log at path, creating it if needed. False if the file
+    // could not be created or mapped, or holds something other than a
+    // sample log.
+    bool
+    open(const std::string &path);
+    void
+    close();
+    bool isOpen() const {
+        return base_ != NULL;
+    }
+    const std::string &getPath() const {
+        return path_;
+    }
+
+    bool
+    append(const sample &s);
+    bool
+    append(const std::vector<sample> &samples);
+
+    // Appends the logged samples to out.
+    void
+    read(std::vector<sample> &out) const;
+    size_t size() const {
+        return size_;
+    }
+
+    // Drops every record.
+    bool
+    clear();
+    // Starts writing the mapped pages back to disk without waiting.
+    void
+    flush();
+
+private:
+    struct header
+    {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t header_size;
+        boost::uint32_t record_size;
+        boost::uint32_t crc; //over the fields above
+        char reserved[40];
+    };
+    struct record
+    {
+        double x, y, counts, weight;
+        boost::uint32_t index;
+        boost::uint32_t crc; //over the fields above
+    };
+    static const boost::uint32_t kVersion = 1;
+    static const size_t kInitialCapacity = 4096; //records
+
+    static boost::uint32_t
+    checksum(const void *data, size_t bytes);
+    record *records() const {
+        return (record*) (base_ + sizeof(header));
+    }
+    bool
+    map(size_t capacity);
+    void
+    unmap();
+
+    //not copyable, owns the descriptor and mapping
+    sampleLog(const sampleLog&);
+    sampleLog &operator=(const sampleLog&);
+
+    std::string path_;
+    int fd_;
+    char *base_;
+    size_t capacity_; //records the mapping holds
+    size_t size_; //records written
+};
+
+#endif /* INCLUDE_RADBOT_PROCESSOR_SAMPLE_LOG_H_ */
@@ -8,17 +8,26 @@
 #ifndef INCLUDE_RADBOT_PROCESSOR_UTIL_H_
 #define INCLUDE_RADBOT_PROCESSOR_UTIL_H_
 
-#include "ros/ros.h"
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "radbot_processor/log.h"
 #define INFLATE 0.15
 
-using namespace std;
-
 typedef struct sample
 {
+    sample() :
+            x(0), y(0), counts(0), weight(1) {
+    }
     double x;
     double y;
     double counts;
+    double weight; //integration time (s), scales the residual in the fit
 } sample;
 
 inline bool cmpX(sample a, sample b) {
@@ -33,20 +42,21 @@ inline bool cmpCounts(sample a, sample b) {
     return (a.counts < b.counts);
 }
 
-inline ostream&
-operator<<(ostream& os, sample a) {
+inline std::ostream&
+operator<<(std::ostream& os, sample a) {
     os << "X val: " << a.x << " Y val: " << a.y << " Counts: " << a.counts;
     return os;
 }
-inline void minimax(vector<sample> &measurements, sample * max, sample * min) {
-    vector<sample>::iterator itr;
-    itr = max_element(measurements.begin(), measurements.end(), cmpX);
+inline void minimax(std::vector<sample> &measurements, sample * max,
+                    sample * min) {
+    std::vector<sample>::iterator itr;
+    itr = std::max_element(measurements.begin(), measurements.end(), cmpX);
     max->x = (*itr).x;
-    itr = max_element(measurements.begin(), measurements.end(), cmpY);
+    itr = std::max_element(measurements.begin(), measurements.end(), cmpY);
     max->y = (*itr).y;
-    itr = min_element(measurements.begin(), measurements.end(), cmpX);
+    itr = std::min_element(measurements.begin(), measurements.end(), cmpX);
     min->x = (*itr).x;
-    itr = min_element(measurements.begin(), measurements.end(), cmpY);
+    itr = std::min_element(measurements.begin(), measurements.end(), cmpY);
     min->y = (*itr).y;
     double inflate;
     inflate = ((max->x - min->x) / 2) * INFLATE;
@@ -58,7 +68,58 @@ inline void minimax(vector<sample> &measurements, sample * max, sample * min) {
 
     min->counts = 0;
     max->counts = 10000000;
-    ROS_INFO_STREAM("Max Vals:" << *max << endl << "Min Vals:" << *min << endl);
+    RADBOT_INFO_STREAM("Max Vals:" << *max << std::endl << "Min Vals:" << *min);
+}
+
+// Reads "x,y,counts[,weight]" lines, skipping any that do not parse
+// (headers), returns false if nothing could be read. The file is read in
+// one go and parsed in place.
+inline bool readCsv(const std::string &name, std::vector<sample> &out) {
+    FILE *f = fopen(name.c_str(), "rb");
+    if (!f)
+        return false;
+    std::string buf;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.append(chunk, n);
+    fclose(f);
+
+    size_t before = out.size();
+    const char *p = buf.c_str(), *end = p + buf.size();
+    while (p < end) {
+        const char *eol = (const char*) memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        sample s;
+        double *fields[4] = { &s.x, &s.y, &s.counts, &s.weight };
+        int got = 0;
+        while (got < 4) {
+            char *next;
+            double v = strtod(p, &next);
+            if (next == p || next > eol)
+                break;
+            *fields[got++] = v;
+            if (*next != ',')
+                break;
+            p = next + 1;
+        }
+        if (got >= 3)
+            out.push_back(s);
+        p = eol + 1;
+    }
+    return out.size() > before;
+}
+
+// Writes "x,y,counts,weight" lines that read back exactly.
+inline bool writeCsv(const std::string &name, const std::vector<sample> &in) {
+    FILE *f = fopen(name.c_str(), "w");
+    if (!f)
+        return false;
+    for (size_t i = 0; i < in.size(); i++)
+        fprintf(f, "%.17g,%.17g,%.17g,%.17g\n", in[i].x, in[i].y,
+                in[i].counts, in[i].weight);
+    return fclose(f) == 0;
 }
 
 #endif /* INCLUDE_RADBOT_PROCESSOR_UTIL_H_ */
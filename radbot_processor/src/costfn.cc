@@ -0,0 +1,216 @@
+/*
+ * costfn.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/costfn.h"
+#include <limits>
+
+double costKernelScalar(const double *ox, const double *oy, const double *oc,
+                        const double *ow, int num_obs, const double *predict,
+                        int num_src) {
+    double cost = 0;
+    for (int i = 0; i < num_obs; i++) { //for each reading
+        double intAt = 0;
+        for (int j = 0; j < num_src; j++) { //for each src
+            double dx = ox[i] - predict[j * 3];
+            double dy = oy[i] - predict[j * 3 + 1];
+            intAt += predict[j * 3 + 2] / (dx * dx + dy * dy);
+        }
+        cost += ow[i] * (intAt - oc[i]) * (intAt - oc[i]);
+    }
+    return cost;
+}
+
+// RMS of a weighted sum of squared residuals. A zero strength source on
+// top of a reading turns into 0/0, scored like any other source on a
+// reading rather than as a NaN, which no cost ever compares below and so
+// stalls the swarm once it is the best.
+static inline double rms(double ssr, double wsum) {
+    return ssr == ssr ? sqrt(ssr / wsum) :
+            std::numeric_limits<double>::infinity();
+}
+
+bool costfn::setKernel(kernel k) {
+#ifdef RADBOT_HAVE_AVX2
+    bool have_avx2 = __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("fma");
+#else
+    bool have_avx2 = false;
+#endif
+    switch (k) {
+    case kAuto:
+        return setKernel(have_avx2 ? kAvx2 : kScalar);
+    case kAvx2:
+        if (!have_avx2)
+            return false;
+#ifdef RADBOT_HAVE_AVX2
+        kernel_fn_ = &costKernelAvx2;
+        kernel_ = kAvx2;
+#endif
+        return true;
+    case kScalar:
+    default:
+        kernel_fn_ = &costKernelScalar;
+        kernel_ = kScalar;
+        return true;
+    }
+}
+
+void costfn::setBackend(backend b, double resolution, size_t budget_bytes) {
+    backend_ = b;
+    if (backend_ == kGrid) {
+        if (!grid_)
+            grid_.reset(new gridTable());
+        grid_->configure(resolution, budget_bytes);
+    }
+}
+
+void costfn::setBinning(double resolution) {
+    if (resolution == bin_res_)
+        return;
+    bin_res_ = resolution;
+    std::vector<sample> obs(obs_);
+    unsigned long readings = readings_;
+    clearAll();
+    for (size_t i = 0; i < obs.size(); i++)
+        addSample(obs[i]);
+    readings_ = readings;
+}
+
+void costfn::addSample(const sample &samp) {
+    readings_++;
+    if (bin_res_ > 0) {
+        boost::uint32_t cx = (boost::int32_t) floor(samp.x / bin_res_);
+        boost::uint32_t cy = (boost::int32_t) floor(samp.y / bin_res_);
+        std::pair<boost::unordered_map<boost::uint64_t, int>::iterator, bool> bin =
+                bins_.insert(
+                        std::make_pair(((boost::uint64_t) cx << 32) | cy,
+                                       (int) obs_.size()));
+        if (!bin.second) {
+            //fold into the existing bin, weight averaged
+            int i = bin.first->second;
+            sample &o = obs_[i];
+            double w = o.weight + samp.weight;
+            if (w > 0) {
+                o.x += (samp.x - o.x) * samp.weight / w;
+                o.y += (samp.y - o.y) * samp.weight / w;
+                o.counts += (samp.counts - o.counts) * samp.weight / w;
+            }
+            o.weight = w;
+            x_[i] = o.x;
+            y_[i] = o.y;
+            c_[i] = o.counts;
+            w_[i] = o.weight;
+            wsum_ += samp.weight;
+            return;
+        }
+    }
+    obs_.push_back(samp);
+    x_.push_back(samp.x);
+    y_.push_back(samp.y);
+    c_.push_back(samp.counts);
+    w_.push_back(samp.weight);
+    wsum_ += samp.weight;
+}
+
+double costfn::getEffectiveObs() const {
+    double sum_sq = 0;
+    for (size_t i = 0; i < w_.size(); i++)
+        sum_sq += w_[i] * w_[i];
+    return sum_sq > 0 ? wsum_ * wsum_ / sum_sq : 0;
+}
+
+void costfn::prepare(const sample &min, const sample &max) const {
+    if (backend_ == kGrid && !x_.empty())
+        grid_->prepare(min, max, &x_[0], &y_[0], x_.size());
+}
+
+void costfn::score(const double *particles, int n_particles, int stride,
+                   int num_src, double *out) const {
+    RADBOT_ASSERT(x_.size() > 0);
+    int num_obs = x_.size();
+    //readings with a table go through the grid, the rest analytically
+    int tabled = 0;
+    if (backend_ == kGrid)
+        tabled = std::min(grid_->size(), num_obs);
+    for (int p = 0; p < n_particles; p++) {
+        const double *predict = particles + (size_t) p * stride;
+        double cost = 0;
+        if (tabled > 0)
+            cost = grid_->sumSquares(predict, num_src, &c_[0], &w_[0]);
+        if (tabled < num_obs)
+            cost += kernel_fn_(&x_[tabled], &y_[tabled], &c_[tabled],
+                               &w_[tabled], num_obs - tabled, predict,
+                               num_src);
+        out[p] = rms(cost, wsum_);
+    }
+}
+
+double costfn::analytic(const double *predict, int num_src) const {
+    RADBOT_ASSERT(x_.size() > 0);
+    double cost = kernel_fn_(&x_[0], &y_[0], &c_[0], &w_[0], x_.size(),
+                             predict, num_src);
+    return rms(cost, wsum_);
+}
+
+double costfn::solveStrengths(const double *pos, int num_src,
+                              double *strengths) const {
+    RADBOT_ASSERT(x_.size() > 0 && num_src <= kMaxSources);
+    int num_obs = x_.size();
+    //normal equations of the weighted linear strength fit, G = A'WA,
+    //b = A'Wc
+    double G[kMaxSources * kMaxSources], b[kMaxSources], s[kMaxSources];
+    double a[kMaxSources];
+    for (int j = 0; j < num_src * num_src; j++)
+        G[j] = 0;
+    for (int j = 0; j < num_src; j++)
+        b[j] = 0;
+    double cc = 0;
+    for (int i = 0; i < num_obs; i++) {
+        for (int j = 0; j < num_src; j++) {
+            double dx = x_[i] - pos[j * 2];
+            double dy = y_[i] - pos[j * 2 + 1];
+            a[j] = 1 / (dx * dx + dy * dy);
+            b[j] += w_[i] * a[j] * c_[i];
+        }
+        for (int j = 0; j < num_src; j++)
+            for (int k = 0; k <= j; k++)
+                G[j * num_src + k] += w_[i] * a[j] * a[k];
+        cc += w_[i] * c_[i] * c_[i];
+    }
+    //a source on top of a reading predicts an infinite rate there, score
+    //it like the analytic kernels would instead of letting inf/inf turn
+    //into a NaN that compares as a perfect fit
+    for (int j = 0; j < num_src; j++)
+        if (!(G[j * num_src + j] < std::numeric_limits<double>::infinity())) {
+            if (strengths)
+                for (int k = 0; k < num_src; k++)
+                    strengths[k] = 0;
+            return std::numeric_limits<double>::infinity();
+        }
+    //scale to unit diagonal, 1/r^4 spans many orders of magnitude
+    double d[kMaxSources];
+    for (int j = 0; j < num_src; j++)
+        d[j] = G[j * num_src + j] > 0 ? 1 / sqrt(G[j * num_src + j]) : 1;
+    for (int j = 0; j < num_src; j++) {
+        for (int k = 0; k <= j; k++) {
+            G[j * num_src + k] *= d[j] * d[k];
+            G[k * num_src + j] = G[j * num_src + k];
+        }
+        b[j] *= d[j];
+    }
+    double obj = nnls(G, b, num_src, s);
+    if (strengths)
+        for (int j = 0; j < num_src; j++)
+            strengths[j] = s[j] * d[j];
+    double cost = cc + obj;
+    return sqrt((cost > 0 ? cost : 0) / wsum_);
+}
+
+void costfn::scorePositions(const double *particles, int n_particles,
+                            int stride, int num_src, double *out) const {
+    for (int p = 0; p < n_particles; p++)
+        out[p] = solveStrengths(particles + (size_t) p * stride, num_src, NULL);
+}
@@ -0,0 +1,40 @@
+/*
+ * costfn_avx2.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  Built with -mavx2 -mfma, only called after a runtime cpu check.
+ */
+#include "radbot_processor/cost_kernel.h"
+#include <immintrin.h>
+
+double costKernelAvx2(const double *ox, const double *oy, const double *oc,
+                      const double *ow, int num_obs, const double *predict,
+                      int num_src) {
+    __m256d acc = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= num_obs; i += 4) { //four readings per lane
+        __m256d x = _mm256_loadu_pd(ox + i);
+        __m256d y = _mm256_loadu_pd(oy + i);
+        __m256d intAt = _mm256_setzero_pd();
+        for (int j = 0; j < num_src; j++) {
+            __m256d dx = _mm256_sub_pd(x, _mm256_set1_pd(predict[j * 3]));
+            __m256d dy = _mm256_sub_pd(y, _mm256_set1_pd(predict[j * 3 + 1]));
+            __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+            intAt = _mm256_add_pd(
+                    intAt,
+                    _mm256_div_pd(_mm256_set1_pd(predict[j * 3 + 2]), r2));
+        }
+        __m256d diff = _mm256_sub_pd(intAt, _mm256_loadu_pd(oc + i));
+        acc = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(ow + i), diff),
+                              diff, acc);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double cost = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    if (i < num_obs)
+        cost += costKernelScalar(ox + i, oy + i, oc + i, ow + i, num_obs - i,
+                                 predict, num_src);
+    return cost;
+}
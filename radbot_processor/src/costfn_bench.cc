@@ -0,0 +1,133 @@
+/*
+ * costfn_bench.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  Microbenchmark for the costfn kernels. Checks every kernel against the
+ *  original sqrt/pow formulation and reports evaluations per second. The
+ *  grid backend is approximate, its error comes from snapping sources to
+ *  the cell centres and is bounded per predicted rate by
+ *  gridTable::kMaxRateError.
+ *
+ *  usage: costfn_bench <data.csv> [sources] [particles] [repeats]
+ */
+#include <vector>
+#include <stdio.h>
+#include <algorithm>
+#include <sys/time.h>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include "radbot_processor/costfn.h"
+
+static double now() {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// The cost function as originally written, kept as the numerical reference.
+static double reference(const std::vector<sample> &obs,
+                        const double *predict, int num_src) {
+    std::vector<double> intAt(obs.size(), 0);
+    double cost = 0;
+    for (size_t i = 0; i < obs.size(); i++) {
+        for (int j = 0; j < num_src; j++) {
+            double radius = sqrt(
+                    pow(obs[i].x - predict[j * 3], 2)
+                            + pow(obs[i].y - predict[j * 3 + 1], 2));
+            intAt[i] += predict[j * 3 + 2] / pow(radius, 2);
+        }
+    }
+    double weight = 0;
+    for (size_t i = 0; i < obs.size(); i++) {
+        cost += obs[i].weight * pow(intAt[i] - obs[i].counts, 2);
+        weight += obs[i].weight;
+    }
+    return pow(cost / weight, 0.5);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "usage: %s <data.csv> [sources] [particles] [repeats]\n",
+                argv[0]);
+        return 1;
+    }
+    std::vector<sample> obs;
+    if (!readCsv(argv[1], obs)) {
+        fprintf(stderr, "could not read %s\n", argv[1]);
+        return 1;
+    }
+    int sources = argc > 2 ? atoi(argv[2]) : 2;
+    int particles = argc > 3 ? atoi(argv[3]) : 5000;
+    int repeats = argc > 4 ? atoi(argv[4]) : 20;
+
+    sample max, min;
+    minimax(obs, &max, &min);
+    boost::random::mt19937 rng(42);
+    boost::random::uniform_real_distribution<double> uniform;
+    int n_vars = 3 * sources;
+    std::vector<double> swarm(particles * n_vars);
+    for (int p = 0; p < particles; p++) {
+        for (int j = 0; j < sources; j++) {
+            swarm[p * n_vars + j * 3] = min.x + (max.x - min.x) * uniform(rng);
+            swarm[p * n_vars + j * 3 + 1] = min.y
+                    + (max.y - min.y) * uniform(rng);
+            swarm[p * n_vars + j * 3 + 2] = min.counts
+                    + (max.counts - min.counts) * uniform(rng);
+        }
+    }
+
+    std::vector<double> ref(particles), out(particles);
+    double t0 = now();
+    for (int p = 0; p < particles; p++)
+        ref[p] = reference(obs, &swarm[p * n_vars], sources);
+    double ref_rate = particles / (now() - t0);
+
+    printf("observations: %d sources: %d particles: %d\n", (int) obs.size(),
+           sources, particles);
+    printf("%-10s %16s %14s\n", "kernel", "evals/s", "max rel err");
+    printf("%-10s %16.0f %14s\n", "reference", ref_rate, "-");
+
+    costfn cost(obs);
+    const char *names[] = { "", "scalar", "avx2" };
+    int status = 0;
+    for (int k = costfn::kScalar; k <= costfn::kAvx2; k++) {
+        if (!cost.setKernel((costfn::kernel) k)) {
+            printf("%-10s %16s %14s\n", names[k], "unsupported", "-");
+            continue;
+        }
+        t0 = now();
+        for (int r = 0; r < repeats; r++)
+            cost.score(&swarm[0], particles, n_vars, sources, &out[0]);
+        double rate = (double) particles * repeats / (now() - t0);
+        double err = 0;
+        for (int p = 0; p < particles; p++) {
+            double e = fabs(out[p] - ref[p]) / fabs(ref[p]);
+            if (e > err)
+                err = e;
+        }
+        printf("%-10s %16.0f %14.3g\n", names[k], rate, err);
+        if (err > 1e-9)
+            status = 2;
+    }
+
+    cost.setKernel(costfn::kAuto);
+    cost.setBackend(costfn::kGrid, 0.05);
+    t0 = now();
+    cost.prepare(min, max);
+    double build = now() - t0;
+    t0 = now();
+    for (int r = 0; r < repeats; r++)
+        cost.score(&swarm[0], particles, n_vars, sources, &out[0]);
+    double rate = (double) particles * repeats / (now() - t0);
+    std::vector<double> errs(particles);
+    for (int p = 0; p < particles; p++)
+        errs[p] = fabs(out[p] - ref[p]) / fabs(ref[p]);
+    std::sort(errs.begin(), errs.end());
+    printf("%-10s %16.0f %14.3g  (median %.3g, tables %.1f MB built in %.3f s)\n",
+           "grid", rate, errs.back(), errs[particles / 2],
+           cost.getGrid()->memoryUsed() / 1048576.0, build);
+    return status;
+}
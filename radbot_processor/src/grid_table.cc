@@ -0,0 +1,136 @@
+/*
+ * grid_table.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/grid_table.h"
+#include <math.h>
+
+const double gridTable::kMaxRateError = 0.0721;
+
+gridTable::gridTable() :
+        resolution_(0.05), budget_(256 << 20), nx_(0), ny_(0) {
+    min_.x = min_.y = min_.counts = 0;
+    max_ = min_;
+}
+
+void gridTable::configure(double resolution, size_t budget_bytes) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (resolution == resolution_ && budget_bytes == budget_)
+        return;
+    resolution_ = resolution;
+    budget_ = budget_bytes;
+    tables_.clear();
+    tx_.clear();
+    ty_.clear();
+    nx_ = ny_ = 0;
+}
+
+void gridTable::prepare(const sample &min, const sample &max,
+                        const double *ox, const double *oy, int num_obs) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (matches(min, max, ox, oy, num_obs))
+        return;
+    if (min.x != min_.x || min.y != min_.y || max.x != max_.x
+            || max.y != max_.y || nx_ == 0) {
+        min_ = min;
+        max_ = max;
+        nx_ = ceil((max_.x - min_.x) / resolution_) + 1;
+        ny_ = ceil((max_.y - min_.y) / resolution_) + 1;
+        tables_.clear();
+        tx_.clear();
+        ty_.clear();
+    }
+
+    //rebuild only the tables whose reading moved, then extend
+    int keep = std::min((int) tables_.size(), num_obs);
+    tables_.resize(keep);
+    tx_.resize(keep);
+    ty_.resize(keep);
+    int built = 0;
+    for (int i = 0; i < keep; i++)
+        if (tx_[i] != ox[i] || ty_[i] != oy[i]) {
+            fillTable(i, ox[i], oy[i]);
+            built++;
+        }
+
+    size_t fit = cells() > 0 ? budget_ / (cells() * sizeof(float)) : 0;
+    for (int i = keep; i < num_obs && tables_.size() < fit; i++, built++) {
+        tables_.push_back(std::vector<float>());
+        tx_.push_back(0);
+        ty_.push_back(0);
+        fillTable(i, ox[i], oy[i]);
+    }
+    if (built > 0)
+        RADBOT_INFO_STREAM(
+                "PSO: Grid tables for " << tables_.size() << "/" << num_obs
+                        << " readings, " << nx_ << "x" << ny_ << " cells, "
+                        << memoryUsed() / (1024 * 1024) << " MB");
+}
+
+// True if prepare() has nothing to build: same bounds, as many tables as
+// fit the budget and none of their readings moved.
+bool gridTable::matches(const sample &min, const sample &max,
+                        const double *ox, const double *oy,
+                        int num_obs) const {
+    if (nx_ == 0 || min.x != min_.x || min.y != min_.y || max.x != max_.x
+            || max.y != max_.y)
+        return false;
+    size_t fit = budget_ / (cells() * sizeof(float));
+    if (tables_.size() != std::min(fit, (size_t) num_obs))
+        return false;
+    for (size_t i = 0; i < tables_.size(); i++)
+        if (tx_[i] != ox[i] || ty_[i] != oy[i])
+            return false;
+    return true;
+}
+
+// Cells closer than kNearCells to the reading hold -1, sumSquares()
+// scores a source snapped to them exactly.
+void gridTable::fillTable(int i, double x, double y) {
+    std::vector<float> &table = tables_[i];
+    table.resize(cells());
+    double near = kNearCells * resolution_;
+    for (int cy = 0; cy < ny_; cy++) {
+        double dy = y - (min_.y + cy * resolution_);
+        float *row = &table[(size_t) cy * nx_];
+        for (int cx = 0; cx < nx_; cx++) {
+            double dx = x - (min_.x + cx * resolution_);
+            double r2 = dx * dx + dy * dy;
+            row[cx] = r2 < near * near ? -1 : 1.0 / r2;
+        }
+    }
+    tx_[i] = x;
+    ty_[i] = y;
+}
+
+double gridTable::sumSquares(const double *predict, int num_src,
+                             const double *oc, const double *ow) const {
+    RADBOT_ASSERT(num_src <= kMaxSources);
+    size_t cell[kMaxSources];
+    for (int j = 0; j < num_src; j++) { //snap each source to a cell
+        int cx = floor((predict[j * 3] - min_.x) / resolution_ + 0.5);
+        int cy = floor((predict[j * 3 + 1] - min_.y) / resolution_ + 0.5);
+        cx = cx < 0 ? 0 : (cx >= nx_ ? nx_ - 1 : cx);
+        cy = cy < 0 ? 0 : (cy >= ny_ ? ny_ - 1 : cy);
+        cell[j] = (size_t) cy * nx_ + cx;
+    }
+    double cost = 0;
+    int num_obs = tables_.size();
+    for (int i = 0; i < num_obs; i++) {
+        const float *table = &tables_[i][0];
+        double intAt = 0;
+        for (int j = 0; j < num_src; j++) {
+            double response = table[cell[j]];
+            if (response < 0) { //near field
+                double dx = tx_[i] - predict[j * 3];
+                double dy = ty_[i] - predict[j * 3 + 1];
+                response = 1 / (dx * dx + dy * dy);
+            }
+            intAt += predict[j * 3 + 2] * response;
+        }
+        cost += ow[i] * (intAt - oc[i]) * (intAt - oc[i]);
+    }
+    return cost;
+}
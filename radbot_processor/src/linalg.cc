@@ -0,0 +1,128 @@
+/*
+ * linalg.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/linalg.h"
+#include <math.h>
+
+bool choleskySolve(double *A, double *b, int n) {
+    for (int j = 0; j < n; j++) {
+        double d = A[j * n + j];
+        for (int k = 0; k < j; k++)
+            d -= A[j * n + k] * A[j * n + k];
+        if (!(d > 0))
+            return false;
+        d = sqrt(d);
+        A[j * n + j] = d;
+        for (int i = j + 1; i < n; i++) {
+            double s = A[i * n + j];
+            for (int k = 0; k < j; k++)
+                s -= A[i * n + k] * A[j * n + k];
+            A[i * n + j] = s / d;
+        }
+    }
+    for (int i = 0; i < n; i++) { //L y = b
+        double s = b[i];
+        for (int k = 0; k < i; k++)
+            s -= A[i * n + k] * b[k];
+        b[i] = s / A[i * n + i];
+    }
+    for (int i = n - 1; i >= 0; i--) { //L' x = y
+        double s = b[i];
+        for (int k = i + 1; k < n; k++)
+            s -= A[k * n + i] * b[k];
+        b[i] = s / A[i * n + i];
+    }
+    return true;
+}
+
+// Unconstrained solve restricted to the passive set, z is 0 elsewhere.
+static bool solvePassive(const double *G, const double *b, int n,
+                         const bool *passive, double *z) {
+    int idx[kMaxLinalg];
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        z[i] = 0;
+        if (passive[i])
+            idx[m++] = i;
+    }
+    double A[kMaxLinalg * kMaxLinalg], y[kMaxLinalg];
+    for (int r = 0; r < m; r++) {
+        for (int c = 0; c < m; c++)
+            A[r * m + c] = G[idx[r] * n + idx[c]];
+        //tiny ridge keeps coincident sources from making G singular
+        A[r * m + r] *= 1 + 1e-12;
+        y[r] = b[idx[r]];
+    }
+    if (!choleskySolve(A, y, m))
+        return false;
+    for (int r = 0; r < m; r++)
+        z[idx[r]] = y[r];
+    return true;
+}
+
+double nnls(const double *G, const double *b, int n, double *x) {
+    bool passive[kMaxLinalg];
+    double z[kMaxLinalg], w[kMaxLinalg];
+    for (int i = 0; i < n; i++) {
+        x[i] = 0;
+        passive[i] = false;
+    }
+    for (int outer = 0; outer < 3 * n; outer++) {
+        //gradient of the objective (negated), w = b - Gx
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            w[i] = b[i];
+            for (int k = 0; k < n; k++)
+                w[i] -= G[i * n + k] * x[k];
+            if (!passive[i] && w[i] > 0 && (best < 0 || w[i] > w[best]))
+                best = i;
+        }
+        if (best < 0 || w[best] <= 1e-12 * fabs(b[best]))
+            break;
+        passive[best] = true;
+        while (true) {
+            if (!solvePassive(G, b, n, passive, z)) {
+                passive[best] = false;
+                break;
+            }
+            int limit = -1;
+            double alpha = 1;
+            for (int i = 0; i < n; i++) {
+                if (passive[i] && z[i] <= 0) {
+                    double a = x[i] / (x[i] - z[i]);
+                    if (limit < 0 || a < alpha) {
+                        alpha = a;
+                        limit = i;
+                    }
+                }
+            }
+            bool feasible = limit < 0;
+            if (feasible) {
+                for (int i = 0; i < n; i++)
+                    x[i] = z[i];
+                break;
+            }
+            //step back to the boundary and drop the variables that hit zero
+            for (int i = 0; i < n; i++) {
+                if (!passive[i])
+                    continue;
+                x[i] += alpha * (z[i] - x[i]);
+                if (x[i] <= 0 || i == limit) {
+                    x[i] = 0;
+                    passive[i] = false;
+                }
+            }
+        }
+    }
+    double obj = 0;
+    for (int i = 0; i < n; i++) {
+        double gx = 0;
+        for (int k = 0; k < n; k++)
+            gx += G[i * n + k] * x[k];
+        obj += x[i] * (gx - 2 * b[i]);
+    }
+    return obj;
+}
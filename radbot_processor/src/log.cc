@@ -0,0 +1,32 @@
+/*
+ * log.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/log.h"
+#include <stdio.h>
+
+static void stderrHandler(logLevel level, const std::string &msg) {
+    static const char *names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+    fprintf(stderr, "[%s] %s\n", names[level], msg.c_str());
+}
+
+static log_fn handler = &stderrHandler;
+static logLevel threshold = kLogInfo;
+
+void setLogHandler(log_fn fn) {
+    handler = fn ? fn : &stderrHandler;
+}
+
+void setLogLevel(logLevel level) {
+    threshold = level;
+}
+
+bool logEnabled(logLevel level) {
+    return level >= threshold;
+}
+
+void logMessage(logLevel level, const std::string &msg) {
+    handler(level, msg);
+}
@@ -5,27 +5,32 @@
  *      Author: hosmar
  */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <ctime>
+#include <dirent.h>
+#include <stdlib.h>
 using namespace std;
 #include <ros/ros.h>
 #include <tf/transform_listener.h>
 #include "ursa_driver/ursa_counts.h"
 #include <std_srvs/Empty.h>
 #include <actionlib/server/simple_action_server.h>
+#include <boost/circular_buffer.hpp>
+#include <boost/thread/mutex.hpp>
 #include "radbot_processor/sampleAction.h"
 #include "radbot_processor/psoAction.h"
 #include "radbot_processor/util.h"
 #include "radbot_processor/pso.h"
-//#define DEBUG
+#include "radbot_processor/model_select.h"
+#include "radbot_processor/sample_log.h"
 
 ros::MultiThreadedSpinner spinner(4);
 
-vector<sample> measurements;
 sample max_val, min_val;
 
 //sample action variables
@@ -33,88 +38,188 @@ ros::NodeHandle * nhp;
 string global_frame;
 string rad_topic;
 actionlib::SimpleActionServer<radbot_processor::sampleAction> * sampleAs;
-radbot_processor::sampleFeedback sampleFb;
-radbot_processor::sampleResult sampleRs;
 ros::Subscriber sample_sub;
 unsigned int sample_count;
 unsigned int sample_goal;
-double sample_sum;
+double sample_sum, sample_x, sample_y, sample_w;
+ros::Time sample_start; //readings stamped earlier belong to an older goal
+//sampleGoalCB runs under the action server's lock, it only raises this flag
+//and drainCB accepts the goal. goal_mutex guards nothing else and neither
+//it nor ingest_mutex is held across sampleAs calls
+bool sample_goal_waiting = false;
+boost::mutex goal_mutex;
+
+//ingestion: sampleCB only queues readings, drainCB resolves their poses
+//from the tf cache in batches and folds them into the active sample, or
+//in continuous mode into the estimator one observation per reading
+struct reading
+{
+    ros::Time stamp;
+    std::string frame_id;
+    double counts;
+    double weight; //integration time (s)
+};
+bool continuous;
+double integration_time, max_integration;
+ros::Time last_stamp;
+//drainCB hands observations to my_cost while no solve runs, during a solve
+//they wait here, the oldest dropped past max_pending
+vector<sample> pending_obs;
+int max_pending;
+boost::mutex solve_mutex; //serializes solves, clear_samples and the hand over
+boost::circular_buffer<reading> ingest_queue;
+boost::mutex ingest_mutex;
+double tf_wait; //seconds a reading may wait for its transform
+unsigned long received = 0, processed = 0, overflowed = 0, tf_dropped = 0,
+        requeue_dropped = 0, pending_dropped = 0;
+ros::WallTime last_report;
+ros::Timer drain_timer;
 
 void sampleGoalCB();
 void samplePreemptCB();
 void sampleCB(const ursa_driver::ursa_countsConstPtr msg);
+void drainCB(const ros::TimerEvent &event);
 
 //pso action variables
 actionlib::SimpleActionServer<radbot_processor::psoAction> * psoAs;
 void psoExecuteCB(const radbot_processor::psoGoalConstPtr &goal);
+bool psoProgressCB(const psoProgress &state);
+bool psoPreemptCheck(const psoProgress &state);
+ros::WallTime last_feedback;
+double feedback_period;
 
 //clearSamples variables
 bool clearSamplesCB(std_srvs::Empty::Request& request,
                     std_srvs::Empty::Response& response);
 
-ifstream infile;
+//every observation is logged as it is queued (under ingest_mutex). Off
+//unless ~sample_log names an absolute path, it is only replayed into the
+//estimator on startup with ~restore_samples, otherwise it is archived.
+//Archives are the log path with a unix time suffix, the ~log_archives
+//newest are kept
+sampleLog sample_log;
+int log_archives;
+bool archiveSamples();
+void pruneArchives(const string &path);
+string export_csv;
+bool exportSamplesCB(std_srvs::Empty::Request& request,
+                     std_srvs::Empty::Response& response);
+
 costfn * my_cost;
 pso * my_pso;
+int threads;
 
 tf::TransformListener * tf_listener;
 
-void
-openFile();
+// The estimator core logs through this into rosconsole.
+void rosLog(logLevel level, const std::string &msg) {
+    switch (level) {
+    case kLogDebug:
+        ROS_DEBUG("%s", msg.c_str());
+        break;
+    case kLogInfo:
+        ROS_INFO("%s", msg.c_str());
+        break;
+    case kLogWarn:
+        ROS_WARN("%s", msg.c_str());
+        break;
+    default:
+        ROS_ERROR("%s", msg.c_str());
+        break;
+    }
+}
 
 int main(int argc, char **argv) {
     ros::init(argc, argv, "radbot_processor");
+    setLogHandler(&rosLog);
     ros::NodeHandle nh;
     ros::NodeHandle pnh("~");
     nhp = &pnh;
     tf_listener = new tf::TransformListener(nh);
 
     pnh.param<std::string>("topic", rad_topic, "counts");
+    pnh.param<std::string>("global_frame", global_frame, "map");
+    int queue_size;
+    double drain_rate;
+    pnh.param("queue_size", queue_size, 1000);
+    pnh.param("drain_rate", drain_rate, 20.0);
+    pnh.param("tf_wait", tf_wait, 1.0);
+    pnh.param("continuous", continuous, false);
+    pnh.param("integration_time", integration_time, 1.0);
+    pnh.param("max_integration", max_integration, 5.0);
+    pnh.param("max_pending", max_pending, 100000);
+    ingest_queue.set_capacity(queue_size);
+    pnh.param("pso_threads", threads,
+              (int) boost::thread::hardware_concurrency());
 
     my_cost = new costfn();
+    double bin_res;
+    pnh.param("bin_resolution", bin_res, 0.05);
+    my_cost->setBinning(bin_res);
+
+    //restore the survey, a CSV file can seed an empty log
+    string log_path, import_csv;
+    bool restore;
+    pnh.param<std::string>("sample_log", log_path, "");
+    pnh.param("restore_samples", restore, false);
+    pnh.param("log_archives", log_archives, 5);
+    pnh.param<std::string>("import_csv", import_csv, "");
+    pnh.param<std::string>("export_csv", export_csv, "");
+    if (!log_path.empty() && log_path[0] != '/') {
+        ROS_ERROR("sample_log must be an absolute path, not logging to %s",
+                  log_path.c_str());
+        log_path.clear();
+    }
+    if (!export_csv.empty() && export_csv[0] != '/') {
+        ROS_ERROR("export_csv must be an absolute path, not exporting to %s",
+                  export_csv.c_str());
+        export_csv.clear();
+    }
+    if (!log_path.empty() && !sample_log.open(log_path))
+        ROS_ERROR("Could not open the sample log %s", log_path.c_str());
+    if (!restore && sample_log.size() > 0)
+        archiveSamples();
+    vector<sample> restored;
+    if (!import_csv.empty() && sample_log.size() > 0)
+        ROS_WARN("Not importing %s, the sample log already holds a survey",
+                 import_csv.c_str());
+    else if (!import_csv.empty()) {
+        if (readCsv(import_csv, restored)) {
+            ROS_INFO("Imported %lu samples from %s",
+                     (unsigned long) restored.size(), import_csv.c_str());
+            sample_log.append(restored);
+        }
+        else
+            ROS_ERROR("Could not import samples from %s", import_csv.c_str());
+    }
+    if (sample_log.isOpen()) {
+        restored.clear();
+        sample_log.read(restored);
+    }
+    for (size_t i = 0; i < restored.size(); i++)
+        my_cost->addSample(restored[i]);
+    if (!restored.empty())
+        ROS_INFO("Restored %lu samples into %lu observations",
+                 (unsigned long) restored.size(),
+                 (unsigned long) my_cost->getObs().size());
     sampleAs =
             new actionlib::SimpleActionServer<radbot_processor::sampleAction>(
                     nh, "process_sampler", false);
     sampleAs->registerGoalCallback(&sampleGoalCB);
     sampleAs->registerPreemptCallback(&samplePreemptCB);
-    sample_sub = nh.subscribe(rad_topic, 1, &sampleCB);
+    sample_sub = nh.subscribe(rad_topic, queue_size, &sampleCB);
+    drain_timer = nh.createTimer(ros::Duration(1.0 / drain_rate), &drainCB);
+    last_report = ros::WallTime::now();
 
     psoAs = new actionlib::SimpleActionServer<radbot_processor::psoAction>(
             nh, "process_pso", &psoExecuteCB, false);
 
     ros::ServiceServer clrSamplesSrv = nh.advertiseService("clear_samples",
                                                            clearSamplesCB);
+    ros::ServiceServer exportSamplesSrv = nh.advertiseService(
+            "export_samples", exportSamplesCB);
 
-    my_pso = new pso(*my_cost, min_val, max_val, 250, 3000, 2);
-
-#ifdef DEBUG
-    openFile();
-    my_cost = new costfn(
-            vector<sample>(measurements.begin(), measurements.end()));
-    pso my_pso2(*my_cost, min_val, max_val, 250, 3000, 2);
-    std::vector<double> result;
-    std::ostream_iterator<double> out_it(std::cout, ", ");
-    clock_t t0 = clock(), t1, t2;
-    /*for (vector<sample>::iterator i = measurements.begin() + 11;
-            i != measurements.end(); i++)
-    {
-        my_cost->addSample(*i);
-        my_pso.setCostFn(*my_cost);
-        result = my_pso.run();
-        std::copy(result.begin(), result.end(), out_it);
-        cout << endl;
-    }*/
-    //for(int i = 0; i<10; i++){
-        t2 = clock();
-        result = my_pso2.run();
-        std::copy(result.begin(), result.end(), out_it);
-        cout << endl;
-        t1 = clock() - t2;
-        cout << (float) t1 / CLOCKS_PER_SEC << endl;
-    //}
-
-    t1 = clock() - t0;
-    cerr << (float) t1 / CLOCKS_PER_SEC << endl;
-#endif
+    my_pso = new pso(*my_cost, min_val, max_val, 250, 3000, 2, threads);
 
     sampleAs->start();
     psoAs->start();
@@ -124,55 +229,189 @@ int main(int argc, char **argv) {
 }
 
 inline void sampleCB(const ursa_driver::ursa_countsConstPtr msg) {
-    if (!sampleAs->isActive())
+    if (!continuous && !sampleAs->isActive())
         return;
-    sample_sum += msg->counts;
-    sample_count++;
-    sampleFb.sample = sample_count;
-    sampleAs->publishFeedback(sampleFb);
-    if (sample_count >= sample_goal) {
+    reading r;
+    r.stamp = msg->header.stamp;
+    r.frame_id = msg->header.frame_id;
+    r.counts = msg->counts;
+    boost::mutex::scoped_lock lock(ingest_mutex);
+    //counts are a rate over the time since the previous message, fall back
+    //to the nominal integration time across gaps and restarts
+    double dt = (r.stamp - last_stamp).toSec();
+    r.weight = dt > 0 && dt <= max_integration ? dt : integration_time;
+    last_stamp = r.stamp;
+    received++;
+    if (ingest_queue.full())
+        overflowed++; //oldest reading is overwritten
+    ingest_queue.push_back(r);
+}
+
+// Localizes queued readings at their own stamps (tf interpolates between
+// cached transforms) without blocking. Readings whose transform has not
+// arrived yet stay queued until tf_wait has passed.
+void drainCB(const ros::TimerEvent &event) {
+    bool new_goal;
+    {
+        boost::mutex::scoped_lock lock(goal_mutex);
+        new_goal = sample_goal_waiting;
+        sample_goal_waiting = false;
+    }
+    if (new_goal && sampleAs->isNewGoalAvailable()) {
+        unsigned int samples = sampleAs->acceptNewGoal()->samples;
+        boost::mutex::scoped_lock lock(ingest_mutex);
+        sample_goal = samples;
+        sample_count = 0;
+        sample_sum = sample_x = sample_y = sample_w = 0;
+        sample_start = ros::Time::now();
+    }
+
+    std::vector<reading> batch;
+    ros::Time start;
+    {
+        boost::mutex::scoped_lock lock(ingest_mutex);
+        start = sample_start;
+        batch.assign(ingest_queue.begin(), ingest_queue.end());
+        ingest_queue.clear();
+    }
+    ros::Time now = ros::Time::now();
+    int done = 0, dropped = 0, counted = 0;
+    double sum = 0, sum_x = 0, sum_y = 0, sum_w = 0;
+    std::vector<sample> observed;
+    for (; done < (int) batch.size(); done++) {
+        reading &r = batch[done];
         tf::StampedTransform transform;
-        int tries = 0;
-        nhp->param<std::string>("global_frame", global_frame, "map");
-        while (!tf_listener->waitForTransform(global_frame,
-                                              msg->header.frame_id,
-                                              msg->header.stamp,
-                                              ros::Duration(1.0))) {
-            ROS_ERROR_STREAM(
-                    "Couldn't transform from \"" << global_frame << "\" to \""
-                            << msg->header.frame_id << "\"");
-            if (tries > 4) {
-                sampleAs->setAborted();
-                return;
+        try {
+            if (!tf_listener->canTransform(global_frame, r.frame_id, r.stamp)) {
+                if ((now - r.stamp).toSec() < tf_wait)
+                    break; //keep order, retry on the next tick
+                ROS_WARN_STREAM_THROTTLE(
+                        5.0,
+                        "Couldn't transform from \"" << global_frame << "\" to \""
+                                << r.frame_id << "\", dropping readings");
+                dropped++;
+                continue;
             }
-            tries++;
+            tf_listener->lookupTransform(global_frame, r.frame_id, r.stamp,
+                                         transform);
         }
+        catch (tf::TransformException &ex) {
+            ROS_WARN_THROTTLE(5.0, "%s", ex.what());
+            dropped++;
+            continue;
+        }
+        if (continuous) {
+            sample obs;
+            obs.x = transform.getOrigin().x();
+            obs.y = transform.getOrigin().y();
+            obs.counts = r.counts;
+            obs.weight = r.weight;
+            observed.push_back(obs);
+        }
+        if (r.stamp < start)
+            continue;
+        sum += r.counts * r.weight;
+        sum_x += transform.getOrigin().x();
+        sum_y += transform.getOrigin().y();
+        sum_w += r.weight;
+        counted++;
+    }
 
-        while (1) {
-            try {
-                tf_listener->lookupTransform(global_frame, msg->header.frame_id,
-                                             msg->header.stamp, transform);
-                break;
-            }
-            catch (tf::TransformException * ex) {
-                ROS_ERROR("%s", ex->what());
-                ros::Duration(1.0).sleep();
+    bool active = counted > 0 && sampleAs->isActive();
+    bool finished = false;
+    radbot_processor::sampleFeedback feedback;
+    radbot_processor::sampleResult result;
+    {
+        boost::mutex::scoped_lock solve_lock(solve_mutex, boost::try_to_lock);
+        boost::mutex::scoped_lock lock(ingest_mutex);
+        pending_obs.insert(pending_obs.end(), observed.begin(),
+                           observed.end());
+        sample_log.append(observed);
+        //unresolved readings go back in front of anything queued meanwhile,
+        //the oldest are lost if sampleCB filled the queue in the meantime
+        int requeued = 0;
+        for (int i = batch.size() - 1; i >= done && !ingest_queue.full();
+                i--, requeued++)
+            ingest_queue.push_front(batch[i]);
+        int lost = batch.size() - done - requeued;
+        if (lost > 0) {
+            requeue_dropped += lost;
+            ROS_WARN_THROTTLE(
+                    5.0,
+                    "Sampling: ingest queue full, dropped %d readings waiting on tf",
+                    lost);
+        }
+        processed += done - dropped;
+        tf_dropped += dropped;
+
+        ros::WallTime wall = ros::WallTime::now();
+        double elapsed = (wall - last_report).toSec();
+        if (elapsed > 10.0) {
+            ROS_INFO(
+                    "Sampling: %.1f readings/s, %lu received, %lu processed, %lu overflowed, %lu without tf, %lu dropped waiting on tf, %lu dropped waiting on a solve",
+                    processed / elapsed, received, processed, overflowed,
+                    tf_dropped, requeue_dropped, pending_dropped);
+            received = processed = overflowed = tf_dropped = requeue_dropped =
+                    pending_dropped = 0;
+            last_report = wall;
+            sample_log.flush();
+        }
+
+        if (active && sample_count < sample_goal) {
+            //the robot holds still while sampling, so the sample sits at
+            //the mean pose of its readings with their exposure weighted rate
+            sample_sum += sum;
+            sample_x += sum_x;
+            sample_y += sum_y;
+            sample_w += sum_w;
+            sample_count += counted;
+            feedback.sample = sample_count;
+            if (sample_count >= sample_goal) {
+                sample temp;
+                temp.x = result.x = sample_x / sample_count;
+                temp.y = result.y = sample_y / sample_count;
+                temp.counts = sample_sum / sample_w;
+                temp.weight = sample_w;
+                ROS_INFO_STREAM("PSO: Newest Sample: " << temp);
+                //in continuous mode its readings are already observations,
+                //the stop only serves as a check
+                if (!continuous) {
+                    pending_obs.push_back(temp);
+                    sample_log.append(temp);
+                    ingest_queue.clear();
+                }
+                finished = true;
             }
         }
-        sample temp;
-        temp.x = sampleRs.x = transform.getOrigin().x();
-        temp.y = sampleRs.y = transform.getOrigin().y();
-        temp.counts = sample_sum / (float) sample_count;
-        ROS_INFO_STREAM("PSO: Newest Sample: " << temp);
-        my_cost->addSample(temp);
-        sampleAs->setSucceeded(sampleRs);
-    }
+        else
+            active = false;
 
+        if (solve_lock.owns_lock()) {
+            for (size_t i = 0; i < pending_obs.size(); i++)
+                my_cost->addSample(pending_obs[i]);
+            pending_obs.clear();
+        }
+        else if (pending_obs.size() > (size_t) max_pending) {
+            size_t excess = pending_obs.size() - max_pending;
+            pending_obs.erase(pending_obs.begin(),
+                              pending_obs.begin() + excess);
+            pending_dropped += excess;
+            ROS_WARN_THROTTLE(
+                    5.0,
+                    "Sampling: more than %d observations waiting on the solve, dropping the oldest",
+                    max_pending);
+        }
+    }
+    //the action server is only called with the locks released
+    if (active)
+        sampleAs->publishFeedback(feedback);
+    if (finished)
+        sampleAs->setSucceeded(result);
 }
+
 inline void sampleGoalCB() {
-    sample_count = 0;
-    sample_sum = 0;
-    sample_goal = sampleAs->acceptNewGoal()->samples;
+    boost::mutex::scoped_lock lock(goal_mutex);
+    sample_goal_waiting = true;
 }
 inline void samplePreemptCB() {
     ROS_INFO("Sampling: Preempted");
@@ -181,75 +420,247 @@ inline void samplePreemptCB() {
 }
 
 void psoExecuteCB(const radbot_processor::psoGoalConstPtr &goal) {
+    //the solver sizes its scratch space for costfn::kMaxSources
+    if (goal->maxSrc <= 0
+            && (goal->numSrc < 1 || goal->numSrc > costfn::kMaxSources)) {
+        ROS_ERROR("PSO: numSrc %d is outside 1..%d", goal->numSrc,
+                  costfn::kMaxSources);
+        psoAs->setAborted(radbot_processor::psoResult(),
+                          "numSrc out of range");
+        return;
+    }
+    if (goal->maxSrc > costfn::kMaxSources) {
+        ROS_ERROR("PSO: maxSrc %d is outside 1..%d", goal->maxSrc,
+                  costfn::kMaxSources);
+        psoAs->setAborted(radbot_processor::psoResult(),
+                          "maxSrc out of range");
+        return;
+    }
+    boost::mutex::scoped_lock solve_lock(solve_mutex);
+    {
+        //new observations only enter the cost function between solves,
+        //take the ones drainCB has not handed over yet
+        boost::mutex::scoped_lock lock(ingest_mutex);
+        for (size_t i = 0; i < pending_obs.size(); i++)
+            my_cost->addSample(pending_obs[i]);
+        pending_obs.clear();
+    }
+    if (my_cost->getObs().empty()) {
+        ROS_WARN("PSO: No samples yet");
+        psoAs->setAborted();
+        return;
+    }
+    ROS_INFO("PSO: %lu readings in %lu observations", my_cost->getReadings(),
+             (unsigned long) my_cost->getObs().size());
+    //solver options are read per goal so they can be switched between solves
+    std::string backend;
+    double grid_res;
+    int grid_mb, iterations, restarts;
+    bool closed_form, lm_refine;
+    nhp->param<std::string>("cost_backend", backend, "analytic");
+    nhp->param("grid_resolution", grid_res, 0.05);
+    nhp->param("grid_memory_mb", grid_mb, 256);
+    nhp->param("closed_form_strengths", closed_form, true);
+    nhp->param("refine", lm_refine, true);
+    nhp->param("pso_iterations", iterations, 300);
+    nhp->param("pso_restarts", restarts, 3);
+    double feedback_rate;
+    nhp->param("feedback_rate", feedback_rate, 2.0);
+    feedback_period = feedback_rate > 0 ? 1.0 / feedback_rate : -1;
+    if (backend == "grid" && closed_form)
+        ROS_WARN_ONCE("PSO: cost_backend grid has no effect with "
+                      "closed_form_strengths, strengths are solved "
+                      "analytically");
+    if (backend == "grid")
+        my_cost->setBackend(costfn::kGrid, grid_res, (size_t) grid_mb << 20);
+    else
+        my_cost->setBackend(costfn::kAnalytic);
+
     vector<sample> temp(my_cost->getObs());
     minimax(temp, &max_val, &min_val);
+    radbot_processor::psoResult res;
+
+    if (goal->maxSrc > 0) {
+        //model order selection, every source count solved at once
+        std::string criterion;
+        nhp->param<std::string>("model_criterion", criterion, "bic");
+        psoOptions options;
+        options.particles = goal->particles;
+        options.iterations = iterations;
+        options.runs = restarts;
+        options.threads = threads;
+        options.closed_form = closed_form;
+        options.refine = lm_refine;
+        options.max_evals = goal->maxEvals > 0 ? goal->maxEvals : 0;
+        options.deadline = goal->deadline;
+        options.progress = &psoPreemptCheck;
+        options.seed = goal->seed ? goal->seed : time(NULL);
+        res.seed = options.seed;
+        std::vector<modelFit> fits;
+        ROS_WARN("PSO: About to Run, 1..%d sources", goal->maxSrc);
+        int best = selectSources(*my_cost, min_val, max_val, goal->maxSrc,
+                                 options, criterion == "aic" ? kAic : kBic,
+                                 fits);
+        res.params = fits[best - 1].params;
+        res.cost = fits[best - 1].cost;
+        res.numSrc = best;
+        for (size_t k = 0; k < fits.size(); k++) {
+            res.costs.push_back(fits[k].cost);
+            res.scores.push_back(fits[k].score);
+        }
+        if (psoAs->isPreemptRequested())
+            psoAs->setPreempted(res);
+        else
+            psoAs->setSucceeded(res);
+        return;
+    }
+
     my_pso->setCostFn(*my_cost);
     my_pso->setParticles(goal->particles);
+    my_pso->setClosedForm(closed_form);
+    my_pso->setRefine(lm_refine);
+    my_pso->setIterations(iterations);
+    my_pso->setRuns(restarts);
     my_pso->setSources(goal->numSrc);
     my_pso->setBounds(max_val, min_val);
+    my_pso->setBudget(goal->maxEvals > 0 ? goal->maxEvals : 0, goal->deadline);
+    my_pso->setProgress(&psoProgressCB);
+    if (goal->seed) {
+        //a replay has to start from the same place as the original solve
+        my_pso->setSeed(goal->seed);
+        my_pso->reset();
+    }
+    last_feedback = ros::WallTime();
 
-    radbot_processor::psoResult res;
     ROS_WARN("PSO: About to Run");
     res.params = my_pso->run();
+    res.seed = my_pso->getSeed();
+    res.warm = my_pso->wasWarm();
     res.cost = my_pso->getGMin();
-    psoAs->setSucceeded(res);
+    res.numSrc = goal->numSrc;
+    //a preempted solve still reports the best estimate so far
+    if (psoAs->isPreemptRequested())
+        psoAs->setPreempted(res);
+    else
+        psoAs->setSucceeded(res);
+}
+
+// Runs on the solver thread once per iteration, stops the solve on preempt
+// and streams the current best at no more than ~feedback_rate Hz.
+bool psoProgressCB(const psoProgress &state) {
+    if (!psoPreemptCheck(state))
+        return false;
+    if (feedback_period < 0)
+        return true;
+    ros::WallTime now = ros::WallTime::now();
+    if ((now - last_feedback).toSec() < feedback_period)
+        return true;
+    last_feedback = now;
+    radbot_processor::psoFeedback fb;
+    fb.cost = state.cost;
+    fb.params = my_pso->currentBest();
+    fb.iteration = state.iteration;
+    fb.run = state.run;
+    fb.evaluations = state.evaluations;
+    psoAs->publishFeedback(fb);
+    return true;
+}
+
+bool psoPreemptCheck(const psoProgress &state) {
+    return ros::ok() && !psoAs->isPreemptRequested();
 }
 
 bool clearSamplesCB(std_srvs::Empty::Request& request,
                     std_srvs::Empty::Response& response) {
+    boost::mutex::scoped_lock solve_lock(solve_mutex);
+    {
+        boost::mutex::scoped_lock lock(ingest_mutex);
+        pending_obs.clear();
+        if (sample_log.size() > 0)
+            archiveSamples();
+    }
     my_cost->clearAll();
+    my_pso->reset();
     ROS_INFO("PSO Samples Reset");
+    return true;
 }
 
-inline void openFile() {
-    try {
-        infile.open("data_4.csv", ifstream::in);
-    }
-    catch (ifstream::failure * e) {
-        ROS_ERROR("Exception opening/reading/closing file");
-    }
-    if (infile.is_open()) {
-        while (infile.good()) {
-            string line;
-            getline(infile, line);
-            if (infile.eof())
-                break;
-
-            stringstream ss(line);
-            sample reading;
-            reading.x = 0.0;
-            reading.y = 0.0;
-            reading.counts = 0.0;
-            try {
-                string num;
-                getline(ss, num, ',');
-                reading.x = atof(num.c_str());
-                num = "";
-
-                getline(ss, num, ',');
-                reading.y = atof(num.c_str());
-                num = "";
-
-                getline(ss, num, ',');
-                reading.counts = atof(num.c_str());
-                ROS_DEBUG_STREAM(
-                        "x val: " << reading.x << " y val: " << reading.y
-                                << " counts: " << reading.counts);
-            }
-            catch (ifstream::failure * e) {
-                ROS_ERROR_STREAM(
-                        "Exception opening/reading/closing file\n"
-                                << e->what());
-            }
-            measurements.push_back(reading);
-        }
-        infile.close();
+// Moves the logged survey aside under a new name and starts an empty log,
+// the log is cleared if that fails. Called with ingest_mutex held once the
+// node runs.
+bool archiveSamples() {
+    string path = sample_log.getPath();
+    ostringstream archive;
+    archive << path << "." << time(NULL);
+    sample_log.close();
+    bool archived = rename(path.c_str(), archive.str().c_str()) == 0;
+    sample_log.open(path);
+    if (!archived) {
+        ROS_ERROR("Could not archive samples to %s", archive.str().c_str());
+        sample_log.clear();
+        return false;
     }
-    else {
-        ROS_ERROR("Error opening file");
-    }
-    ROS_INFO_STREAM("Size of point list:" << measurements.size());
+    ROS_INFO("Samples archived to %s", archive.str().c_str());
+    pruneArchives(path);
+    return true;
+}
 
-    minimax(measurements, &max_val, &min_val);
+// Deletes all but the log_archives newest archives of the log at path,
+// negative keeps them all.
+void pruneArchives(const string &path) {
+    if (log_archives < 0)
+        return;
+    size_t slash = path.rfind('/');
+    string dir = path.substr(0, slash + 1), prefix = path.substr(slash + 1)
+            + ".";
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return;
+    vector<pair<unsigned long, string> > archives;
+    while (dirent *entry = readdir(d)) {
+        string name = entry->d_name;
+        if (name.size() <= prefix.size()
+                || name.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        char *end;
+        unsigned long stamp = strtoul(name.c_str() + prefix.size(), &end, 10);
+        if (*end == '\0')
+            archives.push_back(make_pair(stamp, dir + name));
+    }
+    closedir(d);
+    sort(archives.begin(), archives.end());
+    for (size_t i = 0; i + log_archives < archives.size(); i++) {
+        if (remove(archives[i].second.c_str()) == 0)
+            ROS_INFO("Removed old sample archive %s",
+                     archives[i].second.c_str());
+        else
+            ROS_WARN("Could not remove old sample archive %s",
+                     archives[i].second.c_str());
+    }
+}
 
+bool exportSamplesCB(std_srvs::Empty::Request& request,
+                     std_srvs::Empty::Response& response) {
+    if (export_csv.empty()) {
+        ROS_ERROR("Sample export is disabled, set export_csv to a path");
+        return false;
+    }
+    vector<sample> samples;
+    {
+        boost::mutex::scoped_lock lock(ingest_mutex);
+        if (sample_log.isOpen())
+            sample_log.read(samples);
+    }
+    if (!sample_log.isOpen()) {
+        //without a log only the binned observations are left
+        boost::mutex::scoped_lock solve_lock(solve_mutex);
+        samples = my_cost->getObs();
+    }
+    if (!writeCsv(export_csv, samples)) {
+        ROS_ERROR("Could not export samples to %s", export_csv.c_str());
+        return false;
+    }
+    ROS_INFO("Exported %lu samples to %s", (unsigned long) samples.size(),
+             export_csv.c_str());
+    return true;
 }
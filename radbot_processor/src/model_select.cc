@@ -0,0 +1,78 @@
+/*
+ * model_select.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/model_select.h"
+#include "radbot_processor/pso.h"
+#include <limits>
+#include <boost/bind.hpp>
+
+double modelScore(modelCriterion criterion, double rms, double num_obs,
+                  int num_params) {
+    if (num_params >= num_obs)
+        return std::numeric_limits<double>::infinity();
+    //n ln(RSS / n) with RSS / n = rms^2
+    double fit = num_obs * log(std::max(rms * rms, 1e-300));
+    if (criterion == kAic)
+        return fit + 2.0 * num_params;
+    return fit + num_params * log(num_obs);
+}
+
+static void solveOrder(const costfn *cost, const sample *min,
+                       const sample *max, int sources,
+                       const psoOptions *options, unsigned int threads,
+                       modelFit *fit) {
+    pso solver(*cost, *min, *max, options->particles, options->iterations,
+               sources, threads);
+    solver.setClosedForm(options->closed_form);
+    solver.setRefine(options->refine);
+    solver.setRuns(options->runs);
+    solver.setBudget(options->max_evals, options->deadline);
+    solver.setProgress(options->progress);
+    if (options->seed)
+        solver.setSeed(options->seed);
+    fit->params = solver.run();
+    fit->cost = solver.getGMin();
+}
+
+int selectSources(const costfn &cost, const sample &min, const sample &max,
+                  int max_src, const psoOptions &options,
+                  modelCriterion criterion, std::vector<modelFit> &fits) {
+    RADBOT_ASSERT(max_src >= 1 && max_src <= costfn::kMaxSources);
+    fits.assign(max_src, modelFit());
+    //the solves share the grid tables, build them before fanning out
+    if (!options.closed_form)
+        cost.prepare(min, max);
+    //no more solves at once than there are threads, in waves of k
+    int at_once = std::max(1, std::min(max_src, (int) options.threads));
+    unsigned int per_solve = std::max(1u, options.threads / at_once);
+    for (int first = 1; first <= max_src; first += at_once) {
+        std::vector<boost::thread*> solves;
+        for (int k = first; k < first + at_once && k <= max_src; k++) {
+            solves.push_back(
+                    new boost::thread(
+                            boost::bind(&solveOrder, &cost, &min, &max, k,
+                                        &options, per_solve, &fits[k - 1])));
+        }
+        for (size_t i = 0; i < solves.size(); i++) {
+            solves[i]->join();
+            delete solves[i];
+        }
+    }
+
+    //the RMS is weight normalised, count the observations the same way
+    double num_obs = cost.getEffectiveObs();
+    int best = 1;
+    for (int k = 1; k <= max_src; k++) {
+        modelFit &fit = fits[k - 1];
+        fit.score = modelScore(criterion, fit.cost, num_obs, 3 * k);
+        RADBOT_INFO_STREAM(
+                "PSO: {Model} sources: " << k << " cost: " << fit.cost
+                        << " score: " << fit.score);
+        if (fit.score < fits[best - 1].score)
+            best = k;
+    }
+    return best;
+}
@@ -5,39 +5,345 @@
  *      Author: mike
  */
 #include "radbot_processor/pso.h"
+#include <time.h>
+
+const double pso::kC1_ = 1.49;
+const double pso::kC2_ = 1.49;
+const double pso::kW_ = 0.72;
+const double pso::kStopVal_ = .02;
+const double pso::kReseed_ = .2;
+
+static double monotonicSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
 pso::pso(const costfn& cost_fn, sample mins, sample maxs,
-         unsigned int particles, unsigned int iter, unsigned int sources) :
-        cost_(cost_fn), min_(mins), max_(maxs), n_particles_(particles), n_iter_(
-                iter), sources_(sources), gmin_(100000000), stop_top_(10) {
-    n_vars_ = 3 * sources_;
-    rng_.seed(time(NULL));
+         unsigned int particles, unsigned int iter, unsigned int sources,
+         unsigned int threads) :
+        total_runs_(kTotalRuns_), refine_(false), max_evals_(0), deadline_(
+                0), start_time_(0), stopped_(false), run_index_(0), stop_top_(
+                10), seed_(time(NULL)), solve_(0), iteration_(0), n_threads_(
+                0), generation_(0), pending_(0), shutdown_(false), phase_(
+                kScore), cost_(cost_fn), min_(mins), max_(maxs), n_particles_(
+                particles), n_iter_(iter), n_vars_(0), sources_(sources), gmin_(
+                100000000), prevmin_(1000000), warm_(false), was_warm_(
+                false), closed_form_(false), stride_(3), evals_(0) {
+    n_vars_ = stride_ * sources_;
     setParticles(n_particles_);
+    setThreads(threads);
     gbest_.assign(n_vars_, 0);
 }
 pso::~pso() {
+    stopWorkers();
+}
+
+void pso::setThreads(unsigned int threads) {
+    if (threads < 1)
+        threads = 1;
+    if (threads == n_threads_)
+        return;
+    stopWorkers();
+    n_threads_ = threads;
+    worker_draws_.resize(n_threads_);
+    for (unsigned int i = 1; i < n_threads_; i++) {
+        workers_.push_back(
+                new boost::thread(boost::bind(&pso::workerLoop, this, i)));
+    }
+    RADBOT_INFO_STREAM("PSO: Using " << n_threads_ << " threads.");
+}
+
+void pso::stopWorkers() {
+    {
+        boost::unique_lock<boost::mutex> lock(pool_mutex_);
+        shutdown_ = true;
+    }
+    work_cv_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++) {
+        workers_[i]->join();
+        delete workers_[i];
+    }
+    workers_.clear();
+    shutdown_ = false;
+}
+
+void pso::workerLoop(unsigned int id) {
+    unsigned int seen = 0;
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(pool_mutex_);
+            while (generation_ == seen && !shutdown_)
+                work_cv_.wait(lock);
+            if (shutdown_)
+                return;
+            seen = generation_;
+        }
+        step(id);
+        {
+            boost::unique_lock<boost::mutex> lock(pool_mutex_);
+            if (--pending_ == 0)
+                done_cv_.notify_one();
+        }
+    }
+}
+
+// Runs one phase over the whole swarm, the calling thread takes slice 0.
+void pso::dispatch(phase work) {
+    phase_ = work;
+    evals_ += n_particles_;
+    if (n_threads_ > 1) {
+        {
+            boost::unique_lock<boost::mutex> lock(pool_mutex_);
+            pending_ = n_threads_ - 1;
+            generation_++;
+        }
+        work_cv_.notify_all();
+    }
+    step(0);
+    if (n_threads_ > 1) {
+        boost::unique_lock<boost::mutex> lock(pool_mutex_);
+        while (pending_ > 0)
+            done_cv_.wait(lock);
+    }
+}
+
+// Scores (and for kMove first moves) the particles in slice id, kRescore
+// scores the personal bests instead. Only this slice's rows of v_,
+// particles_ and tmin_ are written, pbest_ and pmin_ are read only, so
+// slices can run concurrently.
+void pso::step(unsigned int id) {
+    int first = (size_t) n_particles_ * id / n_threads_;
+    int last = (size_t) n_particles_ * (id + 1) / n_threads_;
+    if (phase_ == kMove) {
+        double *draws = &worker_draws_[id][0];
+        for (int j = first; j < last; j++) {
+            // find local best
+            double lmin = 1000000000;
+            int lndx = j;
+            for (int p = 0; p < 4; p++) {
+                if (neigh_[ndx(j, p, 4)] >= 0) {
+                    if (lmin > pmin_[neigh_[ndx(j, p, 4)]]) {
+                        lndx = neigh_[ndx(j, p, 4)];
+                        lmin = pmin_[lndx];
+                    }
+                }
+            }
+            //main velocity and position update, the particle's draws for
+            //this iteration in one block
+            rng_.uniforms(j, iteration_, run_index_, draws, 2 * n_vars_);
+            for (unsigned int p = 0; p < n_vars_; p++) {
+                v_[ndx(j, p)] = v_[ndx(j, p)] * kW_
+                        + kC1_ * draws[p]
+                                * (pbest_[ndx(j, p)] - particles_[ndx(j, p)])
+                        + kC2_ * draws[n_vars_ + p]
+                                * (pbest_[ndx(lndx, p)] - particles_[ndx(j, p)]);
+                particles_[ndx(j, p)] += v_[ndx(j, p)];
+            }
+            clampRow(&particles_[ndx(j, 0)]);
+        }
+    }
+    const std::vector<double> &swarm =
+            phase_ == kRescore ? pbest_ : particles_;
+    if (last <= first)
+        return;
+    if (closed_form_)
+        cost_.scorePositions(row(first, swarm), last - first, n_vars_,
+                             sources_, &tmin_[first]);
+    else
+        cost_.score(row(first, swarm), last - first, n_vars_, sources_,
+                    &tmin_[first]);
+}
+
+// Pulls one particle's values inside the search bounds.
+void pso::clampRow(double *row) const {
+    for (unsigned int p = 0; p < sources_; p++) {
+        double *src = row + p * stride_;
+        src[0] = std::min(std::max(src[0], min_.x), max_.x);
+        src[1] = std::min(std::max(src[1], min_.y), max_.y);
+        if (!closed_form_)
+            src[2] = std::min(std::max(src[2], min_.counts), max_.counts);
+    }
+}
+
+// Scatters the kReseed_ share of the kept swarm with the worst personal
+// bests over the bounds again, at rest, so a collapsed swarm can still
+// find a source the new samples point to. gbest is never among them.
+void pso::reseed() {
+    unsigned int count = n_particles_ * kReseed_;
+    if (count < 1 || count >= n_particles_)
+        return;
+    std::vector<std::pair<double, int> > order(n_particles_);
+    for (unsigned int p = 0; p < n_particles_; p++)
+        order[p] = std::make_pair(-pmin_[p], p);
+    std::nth_element(order.begin(), order.begin() + count, order.end());
+    double *draws = &worker_draws_[0][0];
+    for (unsigned int k = 0; k < count; k++) {
+        int p = order[k].second;
+        rng_.uniforms(p, kInitDraw_, run_index_, draws, n_vars_);
+        for (unsigned int i = 0; i < sources_; i++) {
+            particles_[ndx(p, i * stride_)] = min_.x
+                    + (max_.x - min_.x) * draws[i * stride_];
+            particles_[ndx(p, i * stride_ + 1)] = min_.y
+                    + (max_.y - min_.y) * draws[i * stride_ + 1];
+            if (!closed_form_)
+                particles_[ndx(p, i * 3 + 2)] = min_.counts
+                        + (max_.counts - min_.counts) * draws[i * 3 + 2];
+        }
+        std::copy(row(p, particles_), row(p, particles_) + n_vars_,
+                  pbest_.begin() + ndx(p, 0));
+        std::fill(v_.begin() + ndx(p, 0), v_.begin() + ndx(p + 1, 0), 0.0);
+    }
+}
+
+void pso::updateScale() {
+    scale_.resize(n_vars_);
+    for (unsigned int p = 0; p < sources_; p++) {
+        scale_[p * stride_] = max_.x > min_.x ? 1 / (max_.x - min_.x) : 0;
+        scale_[p * stride_ + 1] = max_.y > min_.y ? 1 / (max_.y - min_.y) : 0;
+        if (closed_form_)
+            continue;
+        scale_[p * 3 + 2] =
+                max_.counts > min_.counts ? 1 / (max_.counts - min_.counts) : 0;
+    }
+}
 
+void pso::findBest(const std::vector<double> &swarm) {
+    gmin_ = pmin_[0];
+    std::copy(row(0, swarm), row(0, swarm) + n_vars_, gbest_.begin());
+
+    for (unsigned int i = 1; i < n_particles_; i++) {
+        if (pmin_[i] < gmin_) {
+            gmin_ = pmin_[i];
+            std::copy(row(i, swarm), row(i, swarm) + n_vars_, gbest_.begin());
+        }
+    }
+    converge_.reset(pmin_, stop_top_);
+}
+
+// Iterates the swarm until it collapses or n_iter_ runs out. Returns true
+// on the stop condition, which is not checked before min_iter iterations.
+bool pso::loop(unsigned int min_iter) {
+    for (unsigned int i = 0; i < n_iter_; i++) {
+        //move and score the whole swarm, then fold in the new bests
+        iteration_ = i;
+        dispatch(kMove);
+        for (unsigned int j = 0; j < n_particles_; j++) {
+            //check for new min
+            if (tmin_[j] < pmin_[j]) {
+                std::copy(particles_.begin() + ndx(j, 0),
+                          particles_.begin() + ndx(j + 1, 0),
+                          pbest_.begin() + ndx(j, 0)); //pbest(j,:) = particles(j,:);
+                pmin_[j] = tmin_[j];
+                converge_.update(j);
+                if (pmin_[j] < gmin_) {
+                    gmin_ = pmin_[j];
+                    std::copy(row(j, pbest_), row(j, pbest_) + n_vars_,
+                              gbest_.begin());
+                }
+            }
+        }
+        // stopping criteria, top particles collapsed onto gbest
+        if (i >= min_iter
+                && converge_.converged(pbest_, gbest_, scale_, stride_,
+                                       kStopVal_)) {
+            RADBOT_INFO_STREAM(
+                    "PSO: {Stop condition} cost: " << gmin_ << " iter: " << i);
+            return true;
+        }
+        if (outOfBudget(i)) {
+            RADBOT_INFO_STREAM(
+                    "PSO: {Stopped early} cost: " << gmin_ << " iter: " << i);
+            return false;
+        }
+        RADBOT_DEBUG_STREAM("PSO: iter: " << i);
+    }
+    RADBOT_INFO_STREAM("PSO: {Max iter} cost: " << gmin_);
+    return false;
+}
+
+// Checked once per iteration: evaluation budget, deadline, then the
+// progress hook (which may also ask to stop).
+bool pso::outOfBudget(int iteration) {
+    if (stopped_)
+        return true;
+    if (max_evals_ > 0 && evals_ >= max_evals_)
+        stopped_ = true;
+    else if (deadline_ > 0 && monotonicSeconds() - start_time_ >= deadline_)
+        stopped_ = true;
+    else if (progress_) {
+        psoProgress state;
+        state.run = run_index_;
+        state.iteration = iteration;
+        state.evaluations = evals_;
+        state.cost = gmin_;
+        stopped_ = !progress_(state);
+    }
+    return stopped_;
 }
 
 std::vector<double> pso::run() {
+    evals_ = 0;
+    stopped_ = false;
+    run_index_ = 0;
+    start_time_ = monotonicSeconds();
+    was_warm_ = warm_;
+    if (!warm_) {
+        reset(); //nothing from an earlier solve seeds a cold one
+        solve_ = 0;
+    }
+    rng_.setKey(seed_, solve_++);
+    RADBOT_INFO_STREAM("PSO: Seed " << seed_);
+    for (unsigned int w = 0; w < n_threads_; w++)
+        worker_draws_[w].resize(2 * n_vars_);
+    updateScale();
+    if (!closed_form_) //scorePositions() is analytic only
+        cost_.prepare(min_, max_);
+
+    if (warm_) {
+        //same sources as last time, the samples and bounds changed: pull
+        //the kept swarm into the bounds, scatter its worst part again,
+        //rescore the personal bests and carry on. The kept part has
+        //already collapsed, so the scattered part gets kWarmIter_
+        //iterations before the stop condition may end the run
+        RADBOT_INFO_STREAM("PSO: Warm start");
+        for (unsigned int p = 0; p < n_particles_; p++) {
+            clampRow(&particles_[ndx(p, 0)]);
+            clampRow(&pbest_[ndx(p, 0)]);
+        }
+        reseed();
+        dispatch(kRescore);
+        pmin_ = tmin_;
+        findBest(pbest_);
+        if (!outOfBudget(-1))
+            loop(kWarmIter_);
+        return result();
+    }
+
     prevmin_ = 1000000;
     int run_count = 0;
-    bool stop_cond = false;
-    while (run_count < kTotalRuns_) {
+    while (run_count < total_runs_) {
         v_.assign(n_particles_ * n_vars_, 0);
         particles_.assign(n_particles_ * n_vars_, 0);
         pbest_.assign(n_particles_ * n_vars_, 0);
         pmin_.assign(n_particles_, 0);
+        tmin_.assign(n_particles_, 0);
+        gbest_.resize(n_vars_);
 
-        //initialize randomly
-        for (int p = 0; p < n_particles_; p++) {
-            for (int i = 0; i < sources_; i++) {
-                particles_[ndx(p, i * 3)] = min_.x
-                        + (max_.x - min_.x) * uniform_(rng_);
-                particles_[ndx(p, i * 3 + 1)] = min_.y
-                        + (max_.y - min_.y) * uniform_(rng_);
+        //initialize randomly, iteration word kInitDraw_ keeps these draws
+        //apart from the velocity updates
+        double *draws = &worker_draws_[0][0];
+        for (unsigned int p = 0; p < n_particles_; p++) {
+            rng_.uniforms(p, kInitDraw_, run_index_, draws, n_vars_);
+            for (unsigned int i = 0; i < sources_; i++) {
+                particles_[ndx(p, i * stride_)] = min_.x
+                        + (max_.x - min_.x) * draws[i * stride_];
+                particles_[ndx(p, i * stride_ + 1)] = min_.y
+                        + (max_.y - min_.y) * draws[i * stride_ + 1];
+                if (closed_form_)
+                    continue;
                 particles_[ndx(p, i * 3 + 2)] = min_.counts
-                        + (max_.counts - min_.counts) * uniform_(rng_);
+                        + (max_.counts - min_.counts) * draws[i * 3 + 2];
                 //cerr << particles_[ndx(p, i * 3 + 2)] << endl;
             }
         }
@@ -46,106 +352,15 @@ std::vector<double> pso::run() {
         pbest_ = particles_;
 
         //initial run through cost fn find the global best.
-        pmin_[0] = cost_(GET_ROW(0, particles_));
-        gmin_ = pmin_[0];
-        gbest_ = GET_ROW(0, particles_);
-
-        for (int i = 1; i < n_particles_; i++) {
-            pmin_[i] = cost_(GET_ROW(i, particles_));
-            if (pmin_[i] < gmin_) {
-                gmin_ = pmin_[i];
-                gbest_ = GET_ROW(i, particles_);
-            }
-        }
+        dispatch(kScore);
+        pmin_ = tmin_;
+        findBest(particles_);
 
-        //main loop
-        std::vector<double> lbest(n_vars_, 0);
-        for (int i = 0; i < n_iter_; i++) {
-            for (int j = 0; j < n_particles_; j++) {
-                // find local best
-                double lmin = 1000000000;
-                for (int p = 0; p < 4; p++) {
-                    if (neigh_[ndx(j, p, 4)] >= 0) {
-                        if (lmin > pmin_[neigh_[ndx(j, p, 4)]]) {
-                            lbest = GET_ROW(neigh_[ndx(j, p, 4)], pbest_);
-                            lmin = pmin_[neigh_[ndx(j, p, 4)]];
-                        }
-                    }
-                }
-                //main velocity and position update
-                for (int p = 0; p < n_vars_; p++) {
-                    v_[ndx(j, p)] =
-                            v_[ndx(j, p)] * kW_
-                                    + kC1_ * uniform_(rng_)
-                                            * (pbest_[ndx(j, p)]
-                                                    - particles_[ndx(j, p)])
-                                    + kC2_ * uniform_(rng_)
-                                            * (lbest[p] - particles_[ndx(j, p)]);
-                    particles_[ndx(j, p)] += v_[ndx(j, p)];
-                }
-                //check bounds
-                for (int p = 0; p < sources_; p++) {
-                    if (particles_[ndx(j, p * 3)] > max_.x)
-                        particles_[ndx(j, p * 3)] = max_.x;
-                    if (particles_[ndx(j, p * 3 + 1)] > max_.y)
-                        particles_[ndx(j, p * 3 + 1)] = max_.y;
-                    if (particles_[ndx(j, p * 3 + 2)] > max_.counts)
-                        particles_[ndx(j, p * 3 + 2)] = max_.counts;
-
-                    if (particles_[ndx(j, p * 3)] < min_.x)
-                        particles_[ndx(j, p * 3)] = min_.x;
-                    if (particles_[ndx(j, p * 3 + 1)] < min_.y)
-                        particles_[ndx(j, p * 3 + 1)] = min_.y;
-                    if (particles_[ndx(j, p * 3 + 2)] < min_.counts)
-                        particles_[ndx(j, p * 3 + 2)] = min_.counts;
-                }
-                //check for new min
-                double tmin = cost_(GET_ROW(j, particles_));
-                if (tmin < pmin_[j]) {
-                    std::copy(particles_.begin() + ndx(j, 0),
-                              particles_.begin() + ndx(j + 1, 0),
-                              pbest_.begin() + ndx(j, 0)); //pbest(j,:) = particles(j,:);
-                    pmin_[j] = tmin;
-                    if (pmin_[j] < gmin_) {
-                        gmin_ = pmin_[j];
-                        gbest_ = GET_ROW(j, pbest_);
-                    }
-                }
-                // stopping criteria (sort is costly)
-                std::vector<std::size_t> q(pmin_.size());
-                for (int p = 0; p < q.size(); p++) {
-                    q.at(p) = p;
-                }
-                sortClass sortFn(pmin_);
-                std::partial_sort(q.begin(), q.begin() + stop_top_, q.end(),
-                                  sortFn);
-
-                for (std::vector<std::size_t>::iterator p = q.begin();
-                        p != (q.begin() + stop_top_); p++) {
-                    double result = 0;
-                    for (int x = 0; x < n_vars_; x++) {
-                        result += pow(pbest_[ndx(*p, x)] - gbest_[x], 2);
-                    }
-                    result = pow(result, 0.5);
-                    if (result > kStopVal_)
-                        break;
-                    if (p == (q.begin() + stop_top_ - 1)) { //time to stop
-                        ROS_INFO_STREAM(
-                                "PSO: {Stop condition} cost: " << gmin_ << " iter: " << i);
-                        i = n_iter_;
-                        j = n_particles_;
-                        stop_cond = true;
-                        break;
-                    }
-                }
-            }
-            ROS_DEBUG("PSO: iter: %i", i);
-        }
-        if(!stop_cond){
-            ROS_INFO_STREAM("PSO: {Max iter} cost: " << gmin_);
-        }
-        else
-            stop_cond = false;
+        if (!outOfBudget(-1))
+            loop(0);
+        if (stopped_)
+            break;
+        run_index_++;
         if(gmin_< (prevmin_-.01))
         {
             run_count = 0;
@@ -153,8 +368,50 @@ std::vector<double> pso::run() {
         }
         else
             run_count++;
-        ROS_INFO_STREAM("PSO: Remaining Runs: " << (kTotalRuns_-run_count));
+        RADBOT_INFO_STREAM("PSO: Remaining Runs: " << (total_runs_-run_count));
+    }
+    warm_ = true;
+    return result();
+}
+
+std::vector<double> pso::currentBest() const {
+    std::vector<double> params(3 * sources_);
+    if (closed_form_) {
+        double strengths[costfn::kMaxSources];
+        cost_.solveStrengths(&gbest_[0], sources_, strengths);
+        for (unsigned int p = 0; p < sources_; p++) {
+            params[p * 3] = gbest_[p * 2];
+            params[p * 3 + 1] = gbest_[p * 2 + 1];
+            params[p * 3 + 2] = strengths[p];
+        }
+    }
+    else {
+        params = gbest_;
     }
-    return gbest_;
+    return params;
 }
 
+// currentBest() after the optional local refinement. gmin_ may come from
+// the grid tables while refine() scores analytically, so the swarm's
+// estimate is rescored analytically to choose between them, and gmin_
+// becomes the analytic cost of the one returned.
+std::vector<double> pso::result() {
+    std::vector<double> params = currentBest();
+    if (!refine_)
+        return params;
+
+    double before = cost_.analytic(&params[0], sources_);
+    std::vector<double> polished(params);
+    double refined = refine(cost_, polished, min_, max_);
+    RADBOT_INFO_STREAM("PSO: {Refined} cost: " << before << " -> " << refined);
+    if (!(refined < before)) {
+        gmin_ = before;
+        return params;
+    }
+    gmin_ = refined;
+    //feed the polished estimate back so warm starts keep it
+    for (unsigned int p = 0; p < sources_; p++)
+        for (unsigned int x = 0; x < stride_; x++)
+            gbest_[p * stride_ + x] = polished[p * 3 + x];
+    return polished;
+}
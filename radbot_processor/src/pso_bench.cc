@@ -0,0 +1,217 @@
+/*
+ * pso_bench.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  Runs the full solver on recorded surveys, sweeping particle counts,
+ *  source counts, thread counts and seeds, and prints one CSV row per
+ *  solve so results can be diffed between releases.
+ *
+ *  usage: pso_bench [-p particles,...] [-s sources,...] [-T threads,...]
+ *                   [-n seeds] [-i iterations] [-r restarts]
+ *                   [-m free|closed|both] [-l] [-t truth.csv] [-o out.csv]
+ *                   [data.csv...]
+ *
+ *  -T scoring threads per solve, the same seed gives the same result with
+ *     any count so only wall_s and evals_per_s should move.
+ *  -l polishes the swarm result with Levenberg-Marquardt.
+ *  -t reads known source positions as "dataset,x,y" lines, dataset being
+ *     the file name without directories. src_err_m is the mean distance
+ *     from each known source to its nearest estimate, nan when unknown.
+ *  -o writes the rows to a file instead of stdout, away from solver logs.
+ *  With no files the bundled surveys in the working directory are used.
+ */
+#include <vector>
+#include <string>
+#include <map>
+#include <limits>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "radbot_processor/pso.h"
+
+static const char *kDatasets[] = { "data.csv", "data_i3.csv", "data_i4.csv",
+        "data_o1.csv", "datawval.csv" };
+
+static double now() {
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static std::vector<int> parseList(const char *arg) {
+    std::vector<int> out;
+    std::string s(arg);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end > start)
+            out.push_back(atoi(s.substr(start, end - start).c_str()));
+        start = end + 1;
+    }
+    return out;
+}
+
+static std::string baseName(const std::string &path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+typedef std::map<std::string, std::vector<sample> > truthMap;
+
+static bool readTruth(const char *name, truthMap &truth) {
+    FILE *f = fopen(name, "r");
+    if (!f)
+        return false;
+    char dataset[256];
+    sample s;
+    while (fscanf(f, " %255[^,],%lf,%lf", dataset, &s.x, &s.y) == 3)
+        truth[dataset].push_back(s);
+    fclose(f);
+    return true;
+}
+
+// Mean distance from each known source to the nearest estimate not yet
+// matched, params in the (x, y, strength) layout.
+static double sourceError(const std::vector<sample> &known,
+                          const std::vector<double> &params) {
+    size_t found = params.size() / 3;
+    if (known.empty() || found == 0)
+        return std::numeric_limits<double>::quiet_NaN();
+    std::vector<bool> used(found, false);
+    double total = 0;
+    size_t matched = 0;
+    for (size_t k = 0; k < known.size() && matched < found; k++) {
+        int best = -1;
+        double best_d = 0;
+        for (size_t j = 0; j < found; j++) {
+            if (used[j])
+                continue;
+            double dx = params[j * 3] - known[k].x;
+            double dy = params[j * 3 + 1] - known[k].y;
+            double d = sqrt(dx * dx + dy * dy);
+            if (best < 0 || d < best_d) {
+                best = j;
+                best_d = d;
+            }
+        }
+        used[best] = true;
+        total += best_d;
+        matched++;
+    }
+    return total / matched;
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> particles(1, 250), sources(1, 2), threads(1, 1);
+    int iterations = 3000, seeds = 3;
+    int runs = 10;
+    bool lm = false;
+    std::string mode = "both";
+    truthMap truth;
+    FILE *out = stdout;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:i:s:T:n:r:m:lt:o:")) != -1) {
+        switch (opt) {
+        case 'p':
+            particles = parseList(optarg);
+            break;
+        case 'i':
+            iterations = atoi(optarg);
+            break;
+        case 's':
+            sources = parseList(optarg);
+            break;
+        case 'T':
+            threads = parseList(optarg);
+            break;
+        case 'n':
+            seeds = atoi(optarg);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'm':
+            mode = optarg;
+            break;
+        case 'l':
+            lm = true;
+            break;
+        case 't':
+            if (!readTruth(optarg, truth)) {
+                fprintf(stderr, "could not read %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (!out) {
+                fprintf(stderr, "could not write %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p particles,...] [-s sources,...] "
+                    "[-T threads,...] [-n seeds] [-i iterations] [-r restarts] "
+                    "[-m free|closed|both] [-l] [-t truth.csv] "
+                    "[-o out.csv] [data.csv...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    std::vector<std::string> files(argv + optind, argv + argc);
+    if (files.empty())
+        files.assign(kDatasets,
+                     kDatasets + sizeof(kDatasets) / sizeof(kDatasets[0]));
+
+    fprintf(out, "dataset,mode,particles,sources,threads,seed,evals,wall_s,"
+            "evals_per_s,cost,src_err_m\n");
+    for (size_t f = 0; f < files.size(); f++) {
+        std::vector<sample> obs;
+        if (!readCsv(files[f], obs)) {
+            fprintf(stderr, "could not read %s\n", files[f].c_str());
+            return 1;
+        }
+        std::string name = baseName(files[f]);
+        const std::vector<sample> &known = truth[name];
+        sample max, min;
+        minimax(obs, &max, &min);
+        costfn cost(obs);
+        for (int closed = 0; closed <= 1; closed++) {
+            if ((closed && mode == "free") || (!closed && mode == "closed"))
+                continue;
+            for (size_t p = 0; p < particles.size(); p++) {
+                for (size_t s = 0; s < sources.size(); s++) {
+                    for (size_t t = 0; t < threads.size(); t++) {
+                        for (int seed = 1; seed <= seeds; seed++) {
+                            pso solver(cost, min, max, particles[p],
+                                       iterations, sources[s], threads[t]);
+                            solver.setClosedForm(closed);
+                            solver.setRuns(runs);
+                            solver.setRefine(lm);
+                            solver.setSeed(seed);
+                            double t0 = now();
+                            std::vector<double> params = solver.run();
+                            double wall = now() - t0;
+                            fprintf(out,
+                                    "%s,%s,%d,%d,%u,%d,%lu,%.6f,%.0f,%.6g,%.4g\n",
+                                    name.c_str(), closed ? "closed" : "free",
+                                    particles[p], sources[s],
+                                    solver.getThreads(), seed,
+                                    solver.getEvaluations(), wall,
+                                    solver.getEvaluations() / wall,
+                                    cost(params), sourceError(known, params));
+                            fflush(out);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * refine.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/refine.h"
+#include "radbot_processor/linalg.h"
+
+// Weighted sum of squared residuals, and if JtJ is given the normal
+// equations of the linearised problem (JtWJ, JtWr).
+static double residuals(const std::vector<sample> &obs, const double *p,
+                        int num_src, double *JtJ, double *Jtr) {
+    int n = 3 * num_src;
+    double J[kMaxLinalg];
+    if (JtJ) {
+        for (int a = 0; a < n * n; a++)
+            JtJ[a] = 0;
+        for (int a = 0; a < n; a++)
+            Jtr[a] = 0;
+    }
+    double ssr = 0;
+    for (size_t i = 0; i < obs.size(); i++) {
+        double r = -obs[i].counts;
+        for (int j = 0; j < num_src; j++) {
+            double dx = obs[i].x - p[j * 3];
+            double dy = obs[i].y - p[j * 3 + 1];
+            double inv = 1 / (dx * dx + dy * dy);
+            r += p[j * 3 + 2] * inv;
+            //d(s/d^2)/dx_j = 2 s (ox - x_j) / d^4
+            J[j * 3] = 2 * p[j * 3 + 2] * dx * inv * inv;
+            J[j * 3 + 1] = 2 * p[j * 3 + 2] * dy * inv * inv;
+            J[j * 3 + 2] = inv;
+        }
+        double w = obs[i].weight;
+        ssr += w * r * r;
+        if (!JtJ)
+            continue;
+        for (int a = 0; a < n; a++) {
+            Jtr[a] += w * J[a] * r;
+            for (int b = 0; b <= a; b++)
+                JtJ[a * n + b] += w * J[a] * J[b];
+        }
+    }
+    if (JtJ)
+        for (int a = 0; a < n; a++)
+            for (int b = 0; b < a; b++)
+                JtJ[b * n + a] = JtJ[a * n + b];
+    return ssr;
+}
+
+static void clamp(double *p, int num_src, const sample &min,
+                  const sample &max) {
+    for (int j = 0; j < num_src; j++) {
+        p[j * 3] = std::min(std::max(p[j * 3], min.x), max.x);
+        p[j * 3 + 1] = std::min(std::max(p[j * 3 + 1], min.y), max.y);
+        p[j * 3 + 2] = std::min(std::max(p[j * 3 + 2], min.counts),
+                                max.counts);
+    }
+}
+
+double refine(const costfn &cost, std::vector<double> &params,
+              const sample &min, const sample &max, int max_iter) {
+    const std::vector<sample> &obs = cost.getObs();
+    int num_src = params.size() / 3;
+    int n = params.size();
+    RADBOT_ASSERT(!obs.empty() && n <= kMaxLinalg);
+
+    double JtJ[kMaxLinalg * kMaxLinalg], Jtr[kMaxLinalg];
+    double A[kMaxLinalg * kMaxLinalg], step[kMaxLinalg], trial[kMaxLinalg];
+    double lambda = 1e-3;
+    double ssr = residuals(obs, &params[0], num_src, JtJ, Jtr);
+    for (int it = 0; it < max_iter; it++) {
+        bool accepted = false;
+        while (lambda < 1e10) {
+            //damped normal equations, Marquardt scaling keeps metres and
+            //counts on an equal footing
+            for (int a = 0; a < n * n; a++)
+                A[a] = JtJ[a];
+            for (int a = 0; a < n; a++) {
+                double diag = JtJ[a * n + a] > 0 ? JtJ[a * n + a] : 1e-12;
+                A[a * n + a] += lambda * diag;
+                step[a] = -Jtr[a];
+            }
+            if (choleskySolve(A, step, n)) {
+                for (int a = 0; a < n; a++)
+                    trial[a] = params[a] + step[a];
+                clamp(trial, num_src, min, max);
+                double trial_ssr = residuals(obs, trial, num_src, NULL, NULL);
+                if (trial_ssr < ssr) {
+                    double gain = (ssr - trial_ssr) / ssr;
+                    std::copy(trial, trial + n, params.begin());
+                    ssr = residuals(obs, &params[0], num_src, JtJ, Jtr);
+                    lambda = std::max(lambda / 10, 1e-12);
+                    accepted = true;
+                    if (gain < 1e-12)
+                        it = max_iter;
+                    break;
+                }
+            }
+            lambda *= 10;
+        }
+        if (!accepted)
+            break;
+    }
+    return sqrt(ssr / cost.getWeight());
+}
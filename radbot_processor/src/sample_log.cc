@@ -0,0 +1,197 @@
+/*
+ * sample_log.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include "radbot_processor/sample_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/crc.hpp>
+
+static const char kMagic[8] = { 'R', 'A', 'D', 'B', 'O', 'T', 'S', 'L' };
+const size_t sampleLog::kInitialCapacity;
+
+sampleLog::sampleLog() :
+        fd_(-1), base_(NULL), capacity_(0), size_(0) {
+}
+
+sampleLog::~sampleLog() {
+    close();
+}
+
+boost::uint32_t sampleLog::checksum(const void *data, size_t bytes) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data, bytes);
+    return crc.checksum();
+}
+
+bool sampleLog::open(const std::string &path) {
+    close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        RADBOT_ERROR_STREAM(
+                "Sample log: cannot open " << path << ": " << strerror(errno));
+        return false;
+    }
+    path_ = path;
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        RADBOT_ERROR_STREAM(
+                "Sample log: cannot stat " << path << ": " << strerror(errno));
+        close();
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        if (!map(kInitialCapacity)) {
+            close();
+            return false;
+        }
+        header *h = (header*) base_;
+        memcpy(h->magic, kMagic, sizeof(kMagic));
+        h->version = kVersion;
+        h->header_size = sizeof(header);
+        h->record_size = sizeof(record);
+        h->crc = checksum(h, offsetof(header, crc));
+        return true;
+    }
+
+    //check the header before touching the file
+    header h;
+    if (pread(fd_, &h, sizeof(h), 0) != (ssize_t) sizeof(h)
+            || memcmp(h.magic, kMagic, sizeof(kMagic)) != 0
+            || h.crc != checksum(&h, offsetof(header, crc))
+            || h.version != kVersion || h.header_size != sizeof(header)
+            || h.record_size != sizeof(record)) {
+        RADBOT_ERROR_STREAM("Sample log: " << path << " is not a sample log");
+        close();
+        return false;
+    }
+    size_t capacity = (st.st_size - sizeof(header)) / sizeof(record);
+    if (!map(std::max(capacity, kInitialCapacity))) {
+        close();
+        return false;
+    }
+
+    //keep the valid prefix
+    record *r = records();
+    while (size_ < capacity_ && r[size_].index == size_
+            && r[size_].crc == checksum(&r[size_], offsetof(record, crc)))
+        size_++;
+    if (size_ < capacity_) {
+        //a torn write leaves a bad record, clear everything after it so
+        //stale records can never follow a new one
+        static const record zero = record();
+        if (memcmp(&r[size_], &zero, sizeof(record)) != 0) {
+            RADBOT_WARN_STREAM(
+                    "Sample log: " << path << " is damaged after record "
+                            << size_ << ", dropping the rest");
+            memset(&r[size_], 0, (capacity_ - size_) * sizeof(record));
+        }
+    }
+    RADBOT_INFO_STREAM(
+            "Sample log: " << path << " holds " << size_ << " samples");
+    return true;
+}
+
+void sampleLog::close() {
+    unmap();
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    size_ = 0;
+}
+
+bool sampleLog::map(size_t capacity) {
+    off_t bytes = sizeof(header) + capacity * sizeof(record);
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || (st.st_size < bytes && ftruncate(fd_, bytes))) {
+        RADBOT_ERROR_STREAM(
+                "Sample log: cannot grow " << path_ << ": " << strerror(errno));
+        return false;
+    }
+    void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        RADBOT_ERROR_STREAM(
+                "Sample log: cannot map " << path_ << ": " << strerror(errno));
+        return false;
+    }
+    base_ = (char*) base;
+    capacity_ = capacity;
+    return true;
+}
+
+void sampleLog::unmap() {
+    if (base_)
+        munmap(base_, sizeof(header) + capacity_ * sizeof(record));
+    base_ = NULL;
+    capacity_ = 0;
+}
+
+bool sampleLog::append(const sample &s) {
+    if (!base_)
+        return false;
+    if (size_ == capacity_) {
+        size_t capacity = capacity_ * 2;
+        unmap();
+        if (!map(capacity)) {
+            close();
+            return false;
+        }
+    }
+    record &r = records()[size_];
+    r.x = s.x;
+    r.y = s.y;
+    r.counts = s.counts;
+    r.weight = s.weight;
+    r.index = size_;
+    //the checksum goes in last, a record cut short never validates
+    r.crc = checksum(&r, offsetof(record, crc));
+    size_++;
+    return true;
+}
+
+bool sampleLog::append(const std::vector<sample> &samples) {
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (!append(samples[i]))
+            return false;
+    }
+    return true;
+}
+
+void sampleLog::read(std::vector<sample> &out) const {
+    out.reserve(out.size() + size_);
+    const record *r = records();
+    for (size_t i = 0; i < size_; i++) {
+        sample s;
+        s.x = r[i].x;
+        s.y = r[i].y;
+        s.counts = r[i].counts;
+        s.weight = r[i].weight;
+        out.push_back(s);
+    }
+}
+
+bool sampleLog::clear() {
+    if (!base_)
+        return false;
+    //shrinking the file zeroes the records, the header is kept
+    unmap();
+    size_ = 0;
+    if (ftruncate(fd_, sizeof(header)) != 0 || !map(kInitialCapacity)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void sampleLog::flush() {
+    if (base_)
+        msync(base_, sizeof(header) + size_ * sizeof(record), MS_ASYNC);
+}
@@ -0,0 +1,122 @@
+/*
+ * test_allocation.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  Counts heap allocations through a replaced global operator new, so it
+ *  needs a binary of its own. Scoring and the swarm iterations must not
+ *  allocate: set up happens once per run() and restart.
+ */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <cstddef>
+#include <new>
+#include "radbot_processor/pso.h"
+
+static unsigned long allocations = 0;
+
+static unsigned long allocated() {
+    return __sync_fetch_and_add(&allocations, 0);
+}
+
+void* operator new(size_t bytes) {
+    __sync_fetch_and_add(&allocations, 1);
+    void *p = malloc(bytes ? bytes : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw () {
+    free(p);
+}
+
+//the sized form C++14 calls for complete types, replaced along with the
+//unsized one so every delete reaches free()
+void operator delete(void *p, std::size_t) throw () {
+    free(p);
+}
+
+static std::vector<sample> survey() {
+    std::vector<sample> obs;
+    for (int i = 0; i < 12; i++)
+        for (int j = 0; j < 12; j++) {
+            sample s;
+            s.x = i * 0.5;
+            s.y = j * 0.5;
+            double dx = s.x - 2.2, dy = s.y - 3.1;
+            s.counts = 50 + 4000 / (dx * dx + dy * dy);
+            obs.push_back(s);
+        }
+    return obs;
+}
+
+TEST(Allocation, ScoringIsAllocationFree) {
+    costfn cost(survey());
+    double swarm[2 * 6] = { 1, 1, 1000, 4, 5, 2000, 2, 3, 100, 0.5, 0.5, 10 };
+    double positions[2 * 4] = { 1, 1, 4, 5, 2, 3, 0.5, 0.5 };
+    double out[2], strengths[2];
+    unsigned long before = allocated();
+    cost.score(swarm, 2, 6, 2, out);
+    cost.scorePositions(positions, 2, 4, 2, out);
+    cost.solveStrengths(positions, 2, strengths);
+    EXPECT_EQ(before, allocated());
+}
+
+// Allocation count at every iteration of the solve, per restart.
+static std::vector<unsigned long> seen;
+static std::vector<int> seen_run;
+
+static bool record(const psoProgress &state) {
+    if (state.iteration >= 0 && seen.size() < seen.capacity()) {
+        seen.push_back(allocated());
+        seen_run.push_back(state.run);
+    }
+    return true;
+}
+
+static void expectIterationsAllocationFree(bool closed_form,
+                                           unsigned int threads) {
+    std::vector<sample> obs = survey();
+    sample max, min;
+    minimax(obs, &max, &min);
+    costfn cost(obs);
+    pso solver(cost, min, max, 60, 200, 2, threads);
+    solver.setClosedForm(closed_form);
+    solver.setRuns(2);
+    solver.setSeed(11);
+    solver.setProgress(&record);
+    seen.clear();
+    seen_run.clear();
+    seen.reserve(10000);
+    seen_run.reserve(10000);
+    solver.run();
+    ASSERT_GT(seen.size(), 10u);
+    int steady = 0;
+    for (size_t i = 1; i < seen.size(); i++) {
+        if (seen_run[i] != seen_run[i - 1])
+            continue; //a restart sets the swarm up again
+        EXPECT_EQ(seen[i - 1], seen[i]) << "iteration " << i;
+        steady++;
+    }
+    EXPECT_GT(steady, 10);
+}
+
+TEST(Allocation, SwarmIterationsAreAllocationFree) {
+    expectIterationsAllocationFree(false, 1);
+}
+
+TEST(Allocation, ClosedFormIterationsAreAllocationFree) {
+    expectIterationsAllocationFree(true, 1);
+}
+
+TEST(Allocation, PooledIterationsAreAllocationFree) {
+    expectIterationsAllocationFree(false, 3);
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,102 @@
+/*
+ * test_binning.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "radbot_processor/costfn.h"
+
+static sample reading(double x, double y, double counts, double weight) {
+    sample s;
+    s.x = x;
+    s.y = y;
+    s.counts = counts;
+    s.weight = weight;
+    return s;
+}
+
+// One reading per 0.25 m cell, away from the cell edges, including
+// negative coordinates.
+static std::vector<sample> spread() {
+    std::vector<sample> obs;
+    unsigned int seed = 2;
+    for (int i = -4; i < 8; i++)
+        for (int j = -3; j < 5; j++)
+            obs.push_back(
+                    reading((i + 0.2 + 0.6 * rand_r(&seed) / RAND_MAX) * 0.25,
+                            (j + 0.2 + 0.6 * rand_r(&seed) / RAND_MAX) * 0.25,
+                            rand_r(&seed) % 3000,
+                            0.5 + rand_r(&seed) % 4 * 0.5));
+    return obs;
+}
+
+TEST(Binning, DistinctCellsScoreAsUnbinned) {
+    std::vector<sample> obs = spread();
+    costfn plain(obs), binned;
+    binned.setBinning(0.25);
+    for (size_t i = 0; i < obs.size(); i++)
+        binned.addSample(obs[i]);
+    ASSERT_EQ(obs.size(), binned.getObs().size());
+    EXPECT_EQ(plain.getWeight(), binned.getWeight());
+    EXPECT_EQ(plain.getEffectiveObs(), binned.getEffectiveObs());
+    double predict[6] = { 0.3, 0.4, 800, 1.5, -0.2, 2500 };
+    EXPECT_EQ(plain(predict, 2), binned(predict, 2));
+    double strengths[2];
+    EXPECT_EQ(plain.solveStrengths(predict, 2, NULL),
+              binned.solveStrengths(predict, 2, strengths));
+    //re-binning what was added unbinned gives the same observations
+    plain.setBinning(0.25);
+    EXPECT_EQ(obs.size(), plain.getObs().size());
+    EXPECT_EQ(binned(predict, 2), plain(predict, 2));
+}
+
+// Readings in one cell become a single observation at their weight
+// averaged position and counts, carrying their total weight.
+TEST(Binning, SharedCellIsWeightAveraged) {
+    costfn cost;
+    cost.setBinning(0.5);
+    cost.addSample(reading(0.1, 0.1, 100, 1));
+    cost.addSample(reading(0.3, 0.4, 400, 3));
+    cost.addSample(reading(0.7, 0.1, 50, 2));
+    ASSERT_EQ(2u, cost.getObs().size());
+    EXPECT_EQ(3u, cost.getReadings());
+    const sample &bin = cost.getObs()[0];
+    EXPECT_DOUBLE_EQ(0.25, bin.x);
+    EXPECT_DOUBLE_EQ(0.325, bin.y);
+    EXPECT_DOUBLE_EQ(325, bin.counts);
+    EXPECT_DOUBLE_EQ(4, bin.weight);
+    EXPECT_DOUBLE_EQ(6, cost.getWeight());
+}
+
+// (sum w)^2 / sum w^2
+TEST(Binning, KishEffectiveCount) {
+    costfn cost;
+    EXPECT_EQ(0, cost.getEffectiveObs());
+    for (int i = 0; i < 10; i++)
+        cost.addSample(reading(i, 0, 10, 2));
+    EXPECT_DOUBLE_EQ(10, cost.getEffectiveObs());
+    cost.addSample(reading(20, 0, 10, 20));
+    EXPECT_DOUBLE_EQ(40.0 * 40 / (10 * 4 + 400), cost.getEffectiveObs());
+
+    //binning pairs of equal readings halves it
+    costfn binned;
+    binned.setBinning(1);
+    for (int i = 0; i < 10; i++) {
+        binned.addSample(reading(i + 0.2, 0.5, 10, 1));
+        binned.addSample(reading(i + 0.7, 0.5, 10, 1));
+    }
+    EXPECT_EQ(20u, binned.getReadings());
+    EXPECT_DOUBLE_EQ(10, binned.getEffectiveObs());
+    binned.clearAll();
+    EXPECT_EQ(0, binned.getEffectiveObs());
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
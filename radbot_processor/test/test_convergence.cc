@@ -0,0 +1,123 @@
+/*
+ * test_convergence.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  The top k set kept by convergence, and when it reports the swarm
+ *  collapsed. Membership is read back through converged(): moving a
+ *  tracked particle away from gbest must stop convergence, moving any
+ *  other one must not.
+ */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "radbot_processor/convergence.h"
+
+// One source of (x, y) per particle, everything on gbest but particle
+// away, which sits far off.
+static bool convergedWithout(const convergence &top, int n_particles,
+                             int away) {
+    std::vector<double> pbest(2 * n_particles, 0), gbest(2, 0), scale(2, 1);
+    pbest[2 * away] = pbest[2 * away + 1] = 10;
+    return top.converged(pbest, gbest, scale, 2, 0.1);
+}
+
+static void expectTracks(const convergence &top,
+                         const std::vector<double> &pmin, int k) {
+    std::vector<double> sorted(pmin);
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < pmin.size(); i++) {
+        bool member = pmin[i] <= sorted[k - 1];
+        EXPECT_EQ(!member, convergedWithout(top, pmin.size(), i))
+                << "particle " << i << " cost " << pmin[i];
+    }
+}
+
+TEST(Convergence, TracksTheLowestCosts) {
+    unsigned int seed = 3;
+    const int n = 30, k = 5;
+    std::vector<double> pmin(n);
+    for (int i = 0; i < n; i++) //7 and n coprime, a shuffled ramp
+        pmin[i] = 1000 + (i * 7 % n) * 10 + rand_r(&seed) % 10;
+    convergence top;
+    top.reset(pmin, k);
+    expectTracks(top, pmin, k);
+
+    //personal bests only go down, members and outsiders both improve
+    for (int step = 0; step < 200; step++) {
+        int i = rand_r(&seed) % n;
+        pmin[i] -= 1 + rand_r(&seed) % 200;
+        //costs stay distinct so the top k is well defined
+        while (std::count(pmin.begin(), pmin.end(), pmin[i]) > 1)
+            pmin[i] -= 0.5;
+        top.update(i);
+        expectTracks(top, pmin, k);
+    }
+}
+
+// An outsider beating the worst member evicts that member, the others
+// stay.
+TEST(Convergence, EvictsTheWorstMember) {
+    double costs[] = { 5, 1, 4, 2, 3, 9, 8 };
+    std::vector<double> pmin(costs, costs + 7);
+    convergence top;
+    top.reset(pmin, 3); //particles 1, 3, 4
+    expectTracks(top, pmin, 3);
+    pmin[6] = 2.5; //evicts 4
+    top.update(6);
+    expectTracks(top, pmin, 3);
+    EXPECT_TRUE(convergedWithout(top, 7, 4));
+    pmin[5] = 0.5; //evicts 6
+    top.update(5);
+    expectTracks(top, pmin, 3);
+    EXPECT_TRUE(convergedWithout(top, 7, 6));
+    pmin[0] = 4; //still an outsider
+    top.update(0);
+    expectTracks(top, pmin, 3);
+}
+
+TEST(Convergence, ClampsK) {
+    std::vector<double> pmin(4, 1);
+    pmin[2] = 0;
+    convergence top;
+    top.reset(pmin, 0); //at least one particle, the best
+    EXPECT_FALSE(convergedWithout(top, 4, 2));
+    EXPECT_TRUE(convergedWithout(top, 4, 0));
+    top.reset(pmin, 10); //at most the whole swarm
+    for (int i = 0; i < 4; i++)
+        EXPECT_FALSE(convergedWithout(top, 4, i));
+}
+
+// Distances are scaled per dimension and sources match in any order.
+TEST(Convergence, StopsWhenTheTopCollapses) {
+    std::vector<double> pmin(3);
+    pmin[0] = 1;
+    pmin[1] = 2;
+    pmin[2] = 3;
+    convergence top;
+    top.reset(pmin, 2);
+    //two sources of (x, y, strength), scale is 1 / bounds width
+    double g[] = { 1, 2, 100, 5, 6, 300 };
+    std::vector<double> gbest(g, g + 6);
+    double s[] = { 0.1, 0.1, 0.001, 0.1, 0.1, 0.001 };
+    std::vector<double> scale(s, s + 6);
+    //particle 0 on gbest with its sources swapped, particle 1 0.1 m off
+    //in x on one source (0.01 scaled), particle 2 untracked and far off
+    double p[] = { 5, 6, 300, 1, 2, 100,
+                   1.1, 2, 100, 5, 6, 300,
+                   50, 50, 9000, 50, 50, 9000 };
+    std::vector<double> pbest(p, p + 18);
+    EXPECT_TRUE(top.converged(pbest, gbest, scale, 3, 0.02));
+    EXPECT_FALSE(top.converged(pbest, gbest, scale, 3, 0.005));
+    //strength off by 30 counts is 0.03 scaled
+    pbest[2] = 330;
+    EXPECT_FALSE(top.converged(pbest, gbest, scale, 3, 0.02));
+    EXPECT_TRUE(top.converged(pbest, gbest, scale, 3, 0.04));
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
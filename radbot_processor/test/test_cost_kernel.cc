@@ -0,0 +1,121 @@
+/*
+ * test_cost_kernel.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  The AVX2 kernel against the scalar one, through costfn with the
+ *  dispatch forced each way. The AVX2 kernel sums four lanes and fuses
+ *  multiply-adds, so the two agree to rounding rather than bit for bit.
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "radbot_processor/costfn.h"
+
+static const double kTolerance = 1e-10; //relative
+
+static double uniform(unsigned int *seed, double lo, double hi) {
+    return lo + (hi - lo) * rand_r(seed) / (double) RAND_MAX;
+}
+
+// num_obs readings over a 10 m square, with integration time weights.
+static std::vector<sample> survey(int num_obs, unsigned int seed) {
+    std::vector<sample> obs(num_obs);
+    for (int i = 0; i < num_obs; i++) {
+        obs[i].x = uniform(&seed, 0, 10);
+        obs[i].y = uniform(&seed, 0, 10);
+        obs[i].counts = uniform(&seed, 0, 5000);
+        obs[i].weight = uniform(&seed, 0.5, 2);
+    }
+    return obs;
+}
+
+// n_particles candidates of num_src (x, y, strength) sources.
+static std::vector<double> swarm(int n_particles, int num_src,
+                                 unsigned int seed) {
+    std::vector<double> particles(n_particles * num_src * 3);
+    for (size_t i = 0; i < particles.size(); i += 3) {
+        particles[i] = uniform(&seed, -1, 11);
+        particles[i + 1] = uniform(&seed, -1, 11);
+        particles[i + 2] = uniform(&seed, 0, 1e6);
+    }
+    return particles;
+}
+
+static bool haveAvx2() {
+    costfn probe;
+    return probe.setKernel(costfn::kAvx2);
+}
+
+TEST(CostKernel, DispatchFollowsTheRequest) {
+    costfn cost(survey(8, 1));
+    ASSERT_TRUE(cost.setKernel(costfn::kScalar));
+    EXPECT_EQ(costfn::kScalar, cost.getKernel());
+    bool avx2 = cost.setKernel(costfn::kAvx2);
+    EXPECT_EQ(avx2 ? costfn::kAvx2 : costfn::kScalar, cost.getKernel());
+    ASSERT_TRUE(cost.setKernel(costfn::kAuto));
+    EXPECT_EQ(avx2 ? costfn::kAvx2 : costfn::kScalar, cost.getKernel());
+}
+
+// Every remainder of the four reading lanes, one to four sources.
+TEST(CostKernel, Avx2MatchesScalar) {
+    if (!haveAvx2()) {
+        printf("cpu without AVX2 and FMA, nothing to compare\n");
+        return;
+    }
+    const int n_particles = 50;
+    for (int num_obs = 1; num_obs <= 13; num_obs++) {
+        costfn cost(survey(num_obs, num_obs));
+        for (int num_src = 1; num_src <= 4; num_src++) {
+            std::vector<double> particles = swarm(n_particles, num_src,
+                                                  num_obs * 10 + num_src);
+            std::vector<double> scalar(n_particles), avx2(n_particles);
+            ASSERT_TRUE(cost.setKernel(costfn::kScalar));
+            cost.score(&particles[0], n_particles, 3 * num_src, num_src,
+                       &scalar[0]);
+            ASSERT_TRUE(cost.setKernel(costfn::kAvx2));
+            cost.score(&particles[0], n_particles, 3 * num_src, num_src,
+                       &avx2[0]);
+            for (int p = 0; p < n_particles; p++)
+                EXPECT_NEAR(scalar[p], avx2[p], kTolerance * scalar[p])
+                        << num_obs << " readings, " << num_src
+                        << " sources, particle " << p;
+        }
+    }
+}
+
+// costfn hands the kernels offsets into its arrays, so they must not rely
+// on alignment.
+TEST(CostKernel, Avx2MatchesScalarUnaligned) {
+    if (!haveAvx2()) {
+        printf("cpu without AVX2 and FMA, nothing to compare\n");
+        return;
+    }
+#ifdef RADBOT_HAVE_AVX2
+    std::vector<sample> obs = survey(40, 7);
+    std::vector<double> x, y, c, w;
+    for (size_t i = 0; i < obs.size(); i++) {
+        x.push_back(obs[i].x);
+        y.push_back(obs[i].y);
+        c.push_back(obs[i].counts);
+        w.push_back(obs[i].weight);
+    }
+    std::vector<double> predict = swarm(1, 3, 9);
+    for (int offset = 0; offset < 4; offset++) {
+        int n = obs.size() - offset;
+        double scalar = costKernelScalar(&x[offset], &y[offset], &c[offset],
+                                         &w[offset], n, &predict[0], 3);
+        double avx2 = costKernelAvx2(&x[offset], &y[offset], &c[offset],
+                                     &w[offset], n, &predict[0], 3);
+        EXPECT_NEAR(scalar, avx2, kTolerance * scalar) << "offset " << offset;
+    }
+#endif
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
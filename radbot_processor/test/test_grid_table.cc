@@ -0,0 +1,112 @@
+/*
+ * test_grid_table.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ *
+ *  The grid backend against the analytic one. With every reading at zero
+ *  counts the cost is the weighted RMS of the predicted rates, so each
+ *  rate being within gridTable::kMaxRateError bounds the cost ratio by
+ *  the same amount.
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "radbot_processor/costfn.h"
+
+static double uniform(unsigned int *seed, double lo, double hi) {
+    return lo + (hi - lo) * rand_r(seed) / (double) RAND_MAX;
+}
+
+// Readings scattered over a 6 x 4 m area, at zero counts.
+static costfn quiet(unsigned int seed) {
+    costfn cost;
+    for (int i = 0; i < 60; i++) {
+        sample s;
+        s.x = uniform(&seed, 0, 6);
+        s.y = uniform(&seed, 0, 4);
+        s.weight = uniform(&seed, 0.5, 2);
+        cost.addSample(s);
+    }
+    return cost;
+}
+
+// Largest relative cost error of the grid over random candidates, some
+// with a source right next to a reading.
+static double worstError(double resolution, int num_src) {
+    costfn cost = quiet(num_src);
+    std::vector<sample> obs(cost.getObs());
+    sample min, max;
+    minimax(obs, &max, &min);
+    unsigned int seed = 11;
+    const int n_particles = 2000;
+    std::vector<double> particles(n_particles * num_src * 3);
+    for (int p = 0; p < n_particles; p++)
+        for (int j = 0; j < num_src; j++) {
+            double *src = &particles[(p * num_src + j) * 3];
+            if (p % 4 == 0) { //within a few cells of a reading
+                const sample &o = obs[rand_r(&seed) % obs.size()];
+                src[0] = o.x + uniform(&seed, -3, 3) * resolution;
+                src[1] = o.y + uniform(&seed, -3, 3) * resolution;
+            }
+            else {
+                src[0] = uniform(&seed, min.x, max.x);
+                src[1] = uniform(&seed, min.y, max.y);
+            }
+            src[0] = std::min(std::max(src[0], min.x), max.x);
+            src[1] = std::min(std::max(src[1], min.y), max.y);
+            src[2] = uniform(&seed, 100, 1e5);
+        }
+    std::vector<double> exact(n_particles), grid(n_particles);
+    cost.score(&particles[0], n_particles, 3 * num_src, num_src, &exact[0]);
+    cost.setBackend(costfn::kGrid, resolution);
+    cost.prepare(min, max);
+    EXPECT_EQ((int) obs.size(), cost.getGrid()->size());
+    cost.score(&particles[0], n_particles, 3 * num_src, num_src, &grid[0]);
+    double worst = 0;
+    for (int p = 0; p < n_particles; p++)
+        worst = std::max(worst, fabs(grid[p] - exact[p]) / exact[p]);
+    return worst;
+}
+
+TEST(GridTable, RatesWithinTheBound) {
+    const double resolutions[] = { 0.02, 0.05, 0.1 };
+    for (int r = 0; r < 3; r++)
+        for (int num_src = 1; num_src <= 3; num_src++) {
+            double err = worstError(resolutions[r], num_src);
+            EXPECT_LE(err, gridTable::kMaxRateError)
+                    << resolutions[r] << " m cells, " << num_src
+                    << " sources";
+            //the bound is not met by scoring everything exactly
+            EXPECT_GT(err, 1e-4);
+        }
+}
+
+// Snapped to the cell of the reading the old tables were off by orders of
+// magnitude, the near field is now exact.
+TEST(GridTable, NearFieldIsExact) {
+    costfn cost;
+    sample s;
+    s.x = 1.013;
+    s.y = 2.027;
+    cost.addSample(s);
+    s.x = 3;
+    s.y = 1;
+    cost.addSample(s);
+    sample min, max;
+    min.x = min.y = 0;
+    max.x = max.y = 4;
+    double src[3] = { 1.0, 2.0, 500 };
+    double exact = cost(src, 1);
+    cost.setBackend(costfn::kGrid, 0.05);
+    cost.prepare(min, max);
+    //1 m from the second reading is beyond kNearCells, snapped there
+    EXPECT_NEAR(exact, cost(src, 1), 1e-3 * exact);
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+/*
+ * test_linalg.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <limits>
+#include "radbot_processor/linalg.h"
+
+// Normal equations G = A'A, b = A'y of a rows x n design A.
+static void normalEquations(const double *A, const double *y, int rows,
+                            int n, double *G, double *b) {
+    for (int j = 0; j < n; j++) {
+        b[j] = 0;
+        for (int r = 0; r < rows; r++)
+            b[j] += A[r * n + j] * y[r];
+        for (int k = 0; k < n; k++) {
+            G[j * n + k] = 0;
+            for (int r = 0; r < rows; r++)
+                G[j * n + k] += A[r * n + j] * A[r * n + k];
+        }
+    }
+}
+
+static double objective(const double *G, const double *b, int n,
+                        const double *x) {
+    double obj = 0;
+    for (int i = 0; i < n; i++) {
+        double gx = 0;
+        for (int k = 0; k < n; k++)
+            gx += G[i * n + k] * x[k];
+        obj += x[i] * (gx - 2 * b[i]);
+    }
+    return obj;
+}
+
+static const double kDesign[5 * 3] = { 1.0, 0.2, 0.1, 0.3, 1.0, 0.4, 0.2,
+        0.5, 1.0, 0.9, 0.1, 0.3, 0.4, 0.8, 0.6 };
+
+TEST(Cholesky, SolvesSpdSystem) {
+    double A[3 * 3] = { 4, 2, 0.4, 2, 5, 1, 0.4, 1, 3 };
+    const double x[3] = { 1.5, -2, 0.25 };
+    double b[3];
+    for (int i = 0; i < 3; i++)
+        b[i] = A[i * 3] * x[0] + A[i * 3 + 1] * x[1] + A[i * 3 + 2] * x[2];
+    ASSERT_TRUE(choleskySolve(A, b, 3));
+    for (int i = 0; i < 3; i++)
+        EXPECT_NEAR(x[i], b[i], 1e-12);
+}
+
+TEST(Cholesky, RejectsIndefinite) {
+    double A[2 * 2] = { 1, 2, 2, 1 };
+    double b[2] = { 1, 1 };
+    EXPECT_FALSE(choleskySolve(A, b, 2));
+}
+
+TEST(Nnls, MatchesUnconstrainedWhenPositive) {
+    const double truth[3] = { 2, 0.5, 1 };
+    double y[5];
+    for (int r = 0; r < 5; r++)
+        y[r] = kDesign[r * 3] * truth[0] + kDesign[r * 3 + 1] * truth[1]
+                + kDesign[r * 3 + 2] * truth[2];
+    double G[9], b[3], x[3];
+    normalEquations(kDesign, y, 5, 3, G, b);
+    double obj = nnls(G, b, 3, x);
+    for (int i = 0; i < 3; i++)
+        EXPECT_NEAR(truth[i], x[i], 1e-9);
+    //x'Gx - 2x'b = -y'y for an exact fit
+    double yy = 0;
+    for (int r = 0; r < 5; r++)
+        yy += y[r] * y[r];
+    EXPECT_NEAR(-yy, obj, 1e-9);
+}
+
+// With a negative unconstrained solution the result has to match the best
+// of every active set, found by brute force.
+TEST(Nnls, MatchesBruteForceWhenConstrained) {
+    const double y[5] = { 1.0, -2.0, 0.5, 3.0, -1.0 };
+    double G[9], b[3], x[3];
+    normalEquations(kDesign, y, 5, 3, G, b);
+    double obj = nnls(G, b, 3, x);
+    for (int i = 0; i < 3; i++)
+        EXPECT_GE(x[i], 0.0);
+    EXPECT_NEAR(objective(G, b, 3, x), obj, 1e-12);
+
+    double best = std::numeric_limits<double>::infinity();
+    for (int mask = 0; mask < 8; mask++) {
+        int idx[3], m = 0;
+        for (int i = 0; i < 3; i++)
+            if (mask & (1 << i))
+                idx[m++] = i;
+        double A[9], z[3], full[3] = { 0, 0, 0 };
+        for (int r = 0; r < m; r++) {
+            for (int c = 0; c < m; c++)
+                A[r * m + c] = G[idx[r] * 3 + idx[c]];
+            z[r] = b[idx[r]];
+        }
+        if (m > 0 && !choleskySolve(A, z, m))
+            continue;
+        bool feasible = true;
+        for (int r = 0; r < m; r++) {
+            feasible &= z[r] >= 0;
+            full[idx[r]] = z[r];
+        }
+        if (feasible)
+            best = std::min(best, objective(G, b, 3, full));
+    }
+    EXPECT_NEAR(best, obj, 1e-9);
+}
+
+TEST(Nnls, AllNegativeGivesZero) {
+    double G[4] = { 2, 0.5, 0.5, 1 };
+    double b[2] = { -1, -0.5 };
+    double x[2];
+    EXPECT_EQ(0.0, nnls(G, b, 2, x));
+    EXPECT_EQ(0.0, x[0]);
+    EXPECT_EQ(0.0, x[1]);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,97 @@
+/*
+ * test_model_select.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include "radbot_processor/model_select.h"
+
+// Readings on a lawnmower path 0.05 m apart around a single source, with
+// Gaussian noise, binned the way the node bins them.
+static void survey(costfn &cost, double bin_res) {
+    unsigned int seed = 5;
+    cost.setBinning(bin_res);
+    for (int i = 0; i < 80; i++)
+        for (int j = 0; j < 80; j++) {
+            sample s;
+            s.x = i * 0.05;
+            s.y = j * 0.05;
+            double dx = s.x - 1.32, dy = s.y - 2.73;
+            if (dx * dx + dy * dy < 0.25)
+                continue; //the path keeps clear of the source
+            double rate = 3000 / (dx * dx + dy * dy);
+            //Box-Muller
+            double u1 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+            double u2 = (rand_r(&seed) + 1.0) / (RAND_MAX + 2.0);
+            s.counts = rate + 20 * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+            cost.addSample(s);
+        }
+}
+
+static int selectedSources(double bin_res) {
+    costfn cost;
+    survey(cost, bin_res);
+    sample max, min;
+    std::vector<sample> obs(cost.getObs());
+    minimax(obs, &max, &min);
+    psoOptions options;
+    options.particles = 60;
+    options.iterations = 150;
+    options.runs = 2;
+    options.seed = 3;
+    std::vector<modelFit> fits;
+    int best = selectSources(cost, min, max, 3, options, kBic, fits);
+    //the criterion counts what the RMS was taken over
+    double sum_w = 0, sum_sq = 0;
+    for (size_t i = 0; i < obs.size(); i++) {
+        sum_w += obs[i].weight;
+        sum_sq += obs[i].weight * obs[i].weight;
+    }
+    EXPECT_NEAR(sum_w * sum_w / sum_sq, cost.getEffectiveObs(), 1e-6);
+    for (int k = 1; k <= 3; k++)
+        EXPECT_EQ(modelScore(kBic, fits[k - 1].cost, cost.getEffectiveObs(),
+                             3 * k),
+                  fits[k - 1].score);
+    return best;
+}
+
+TEST(ModelSelect, SingleSourceSelectsOne) {
+    EXPECT_EQ(1, selectedSources(0));
+}
+
+TEST(ModelSelect, SingleSourceSelectsOneWhenBinned) {
+    EXPECT_EQ(1, selectedSources(0.1));
+}
+
+// Fewer threads than source counts runs the solves in waves, each solve
+// is seeded so the fits do not depend on how they were scheduled.
+TEST(ModelSelect, WavesMatchOneThreadPerOrder) {
+    costfn cost;
+    survey(cost, 0.1);
+    sample max, min;
+    std::vector<sample> obs(cost.getObs());
+    minimax(obs, &max, &min);
+    psoOptions options;
+    options.particles = 40;
+    options.iterations = 100;
+    options.runs = 1;
+    options.seed = 3;
+    std::vector<modelFit> waves, parallel;
+    options.threads = 2;
+    int best = selectSources(cost, min, max, 3, options, kBic, waves);
+    options.threads = 3;
+    EXPECT_EQ(best, selectSources(cost, min, max, 3, options, kBic, parallel));
+    for (int k = 0; k < 3; k++) {
+        EXPECT_EQ(parallel[k].params, waves[k].params);
+        EXPECT_EQ(parallel[k].cost, waves[k].cost);
+    }
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
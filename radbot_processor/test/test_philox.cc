@@ -0,0 +1,88 @@
+/*
+ * test_philox.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include "radbot_processor/philox.h"
+
+static void expectBlock(boost::uint32_t k0, boost::uint32_t k1,
+                        const boost::uint32_t ctr[4],
+                        const boost::uint32_t expect[4]) {
+    philox rng(k0, k1);
+    boost::uint32_t out[4];
+    rng.block(ctr, out);
+    for (int i = 0; i < 4; i++)
+        EXPECT_EQ(expect[i], out[i]) << "word " << i;
+}
+
+// Known answers for philox4x32-10 from the Random123 kat_vectors file.
+TEST(Philox, KnownAnswerZero) {
+    const boost::uint32_t ctr[4] = { 0, 0, 0, 0 };
+    const boost::uint32_t expect[4] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+            0x9b00dbd8 };
+    expectBlock(0, 0, ctr, expect);
+}
+
+TEST(Philox, KnownAnswerOnes) {
+    const boost::uint32_t ctr[4] = { 0xffffffff, 0xffffffff, 0xffffffff,
+            0xffffffff };
+    const boost::uint32_t expect[4] = { 0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+            0x6d5451fd };
+    expectBlock(0xffffffff, 0xffffffff, ctr, expect);
+}
+
+TEST(Philox, KnownAnswerPi) {
+    const boost::uint32_t ctr[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e,
+            0x03707344 };
+    const boost::uint32_t expect[4] = { 0xd16cfe09, 0x94fdcceb, 0x5001e420,
+            0x24126ea1 };
+    expectBlock(0xa4093822, 0x299f31d0, ctr, expect);
+}
+
+TEST(Philox, UniformsAreOpenInterval) {
+    philox rng(1, 2);
+    double draws[1001];
+    rng.uniforms(0, 0, 0, draws, 1001);
+    double sum = 0;
+    for (int i = 0; i < 1001; i++) {
+        EXPECT_GT(draws[i], 0.0);
+        EXPECT_LT(draws[i], 1.0);
+        sum += draws[i];
+    }
+    EXPECT_NEAR(0.5, sum / 1001, 0.05);
+}
+
+// A draw only depends on its coordinates, not on what was drawn before or
+// how many values were asked for.
+TEST(Philox, DrawsDependOnlyOnCoordinates) {
+    philox a(7, 3), b(7, 3);
+    double first[6], again[6], longer[10], other[6];
+    a.uniforms(5, 9, 1, first, 6);
+    b.uniforms(1, 1, 1, other, 6);
+    b.uniforms(5, 9, 1, again, 6);
+    b.uniforms(5, 9, 1, longer, 10);
+    for (int i = 0; i < 6; i++) {
+        EXPECT_EQ(first[i], again[i]);
+        EXPECT_EQ(first[i], longer[i]);
+    }
+    bool differs = false;
+    for (int i = 0; i < 6; i++)
+        differs |= first[i] != other[i];
+    EXPECT_TRUE(differs);
+}
+
+TEST(Philox, KeySelectsStream) {
+    philox a(7, 3), b(7, 4);
+    double x[4], y[4];
+    a.uniforms(0, 0, 0, x, 4);
+    b.uniforms(0, 0, 0, y, 4);
+    for (int i = 0; i < 4; i++)
+        EXPECT_NE(x[i], y[i]);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
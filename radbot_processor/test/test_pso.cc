@@ -0,0 +1,154 @@
+/*
+ * test_pso.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "radbot_processor/pso.h"
+
+static const unsigned int kParticles = 50;
+
+// A single source seen from a grid of readings.
+static costfn survey() {
+    costfn cost;
+    for (int i = 0; i < 15; i++)
+        for (int j = 0; j < 15; j++) {
+            sample s;
+            s.x = i * 0.4;
+            s.y = j * 0.4;
+            double dx = s.x - 2.1, dy = s.y - 3.3;
+            s.counts = 20 + 5000 / (dx * dx + dy * dy + 0.5);
+            cost.addSample(s);
+        }
+    return cost;
+}
+
+static void bounds(const costfn &cost, sample *min, sample *max) {
+    std::vector<sample> obs(cost.getObs());
+    minimax(obs, max, min);
+}
+
+// Keeps the personal bests as they were right after the swarm was scored.
+struct scoredSwarm
+{
+    scoredSwarm(const pso *solver, std::vector<double> *out) :
+            solver(solver), out(out) {
+    }
+    bool operator()(const psoProgress &state) {
+        if (state.iteration == -1)
+            *out = solver->getPersonalBests();
+        return true;
+    }
+    const pso *solver;
+    std::vector<double> *out;
+};
+
+// A warm run scatters exactly the kReseed_ share of the kept swarm, the
+// particles with the worst personal bests, and then runs kWarmIter_
+// iterations before the stop condition may end it.
+TEST(Pso, WarmStartReseedsTheWorstShare) {
+    costfn cost = survey();
+    sample min, max;
+    bounds(cost, &min, &max);
+    pso solver(cost, min, max, kParticles, 1000, 1);
+    solver.setClosedForm(true);
+    solver.setSeed(5);
+    solver.run();
+    ASSERT_FALSE(solver.wasWarm());
+    std::vector<double> kept = solver.getPersonalBests();
+    ASSERT_EQ(kParticles * 2, kept.size());
+
+    std::vector<double> rescored;
+    solver.setProgress(scoredSwarm(&solver, &rescored));
+    solver.run();
+    ASSERT_TRUE(solver.wasWarm());
+    ASSERT_EQ(kept.size(), rescored.size());
+
+    //the bounds did not change, so clamping moved nothing
+    std::vector<std::pair<double, unsigned int> > order;
+    std::vector<bool> moved(kParticles);
+    unsigned int count = 0;
+    for (unsigned int p = 0; p < kParticles; p++) {
+        double cost_p;
+        cost.scorePositions(&kept[p * 2], 1, 0, 1, &cost_p);
+        order.push_back(std::make_pair(-cost_p, p));
+        moved[p] = kept[p * 2] != rescored[p * 2]
+                || kept[p * 2 + 1] != rescored[p * 2 + 1];
+        count += moved[p];
+    }
+    unsigned int share = kParticles * pso::kReseed_;
+    EXPECT_EQ(share, count);
+    std::sort(order.begin(), order.end());
+    for (unsigned int k = 0; k < kParticles; k++)
+        EXPECT_EQ(k < share, moved[order[k].second])
+                << "rank " << k << " cost " << -order[k].first;
+
+    //one rescore of the swarm, then at least kWarmIter_ + 1 iterations,
+    //ended by the stop condition rather than the iteration limit
+    const unsigned int warm_iter = pso::kWarmIter_;
+    EXPECT_GE(solver.getEvaluations(), (warm_iter + 2) * kParticles);
+    EXPECT_LT(solver.getEvaluations(), 1001 * kParticles);
+    EXPECT_FALSE(solver.wasStopped());
+}
+
+// Replaying a seed with reset() gives the same estimate bit for bit, even
+// after the solver ran on other seeds in between.
+TEST(Pso, ResetReplaysTheSeed) {
+    costfn cost = survey();
+    sample min, max;
+    bounds(cost, &min, &max);
+    pso solver(cost, min, max, kParticles, 200, 2);
+    solver.setSeed(9);
+    std::vector<double> first = solver.run();
+    unsigned long evals = solver.getEvaluations();
+    double gmin = solver.getGMin();
+
+    solver.setSeed(10);
+    solver.reset();
+    solver.run();
+    solver.run(); //warm
+
+    solver.setSeed(9);
+    solver.reset();
+    std::vector<double> replay = solver.run();
+    ASSERT_FALSE(solver.wasWarm());
+    ASSERT_EQ(first.size(), replay.size());
+    for (size_t i = 0; i < first.size(); i++)
+        EXPECT_EQ(first[i], replay[i]) << "param " << i;
+    EXPECT_EQ(evals, solver.getEvaluations());
+    EXPECT_EQ(gmin, solver.getGMin());
+}
+
+// The thread count only changes who scores a particle, not its draws.
+TEST(Pso, ThreadCountDoesNotChangeTheResult) {
+    costfn cost = survey();
+    sample min, max;
+    bounds(cost, &min, &max);
+    std::vector<double> single;
+    unsigned long evals = 0;
+    for (unsigned int threads = 1; threads <= 4; threads += 3) {
+        pso solver(cost, min, max, kParticles, 200, 2, threads);
+        solver.setClosedForm(true);
+        solver.setSeed(3);
+        std::vector<double> params = solver.run();
+        if (threads == 1) {
+            single = params;
+            evals = solver.getEvaluations();
+            continue;
+        }
+        ASSERT_EQ(single.size(), params.size());
+        for (size_t i = 0; i < single.size(); i++)
+            EXPECT_EQ(single[i], params[i]) << "param " << i;
+        EXPECT_EQ(evals, solver.getEvaluations());
+    }
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,97 @@
+/*
+ * test_refine.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "radbot_processor/pso.h"
+#include "radbot_processor/refine.h"
+
+static double uniform(unsigned int *seed, double lo, double hi) {
+    return lo + (hi - lo) * rand_r(seed) / (double) RAND_MAX;
+}
+
+// Two sources seen from a lawnmower path, with noise so no fit is exact.
+static costfn survey() {
+    costfn cost;
+    unsigned int seed = 4;
+    for (int i = 0; i < 20; i++)
+        for (int j = 0; j < 12; j++) {
+            sample s;
+            s.x = i * 0.3;
+            s.y = j * 0.3;
+            double d1 = pow(s.x - 1.2, 2) + pow(s.y - 2.5, 2);
+            double d2 = pow(s.x - 4.6, 2) + pow(s.y - 0.8, 2);
+            s.counts = 30 + 2000 / (d1 + 0.3) + 900 / (d2 + 0.3)
+                    + uniform(&seed, -40, 40);
+            s.weight = uniform(&seed, 0.5, 1.5);
+            cost.addSample(s);
+        }
+    return cost;
+}
+
+// From random starts, including ones far from either source, the polished
+// estimate is never worse, stays in the bounds and is scored like the
+// analytic cost function would.
+TEST(Refine, NeverIncreasesTheCost) {
+    costfn cost = survey();
+    std::vector<sample> obs(cost.getObs());
+    sample min, max;
+    minimax(obs, &max, &min);
+    unsigned int seed = 8;
+    for (int trial = 0; trial < 60; trial++) {
+        int num_src = 1 + trial % 3;
+        std::vector<double> params(3 * num_src);
+        for (int j = 0; j < num_src; j++) {
+            params[j * 3] = uniform(&seed, min.x, max.x);
+            params[j * 3 + 1] = uniform(&seed, min.y, max.y);
+            params[j * 3 + 2] = uniform(&seed, 0, 5000);
+        }
+        double start = cost(params);
+        double refined = refine(cost, params, min, max);
+        EXPECT_LE(refined, start) << "trial " << trial;
+        EXPECT_NEAR(cost(params), refined, 1e-9 * start) << "trial " << trial;
+        for (int j = 0; j < num_src; j++) {
+            EXPECT_GE(params[j * 3], min.x);
+            EXPECT_LE(params[j * 3], max.x);
+            EXPECT_GE(params[j * 3 + 1], min.y);
+            EXPECT_LE(params[j * 3 + 1], max.y);
+            EXPECT_GE(params[j * 3 + 2], min.counts);
+        }
+    }
+}
+
+// With the grid backend the swarm's costs are approximate, the reported
+// cost is still the analytic cost of the returned estimate and refining
+// does not make it worse than the unrefined one.
+TEST(Refine, SolverReportsTheAnalyticCost) {
+    costfn cost = survey();
+    std::vector<sample> obs(cost.getObs());
+    sample min, max;
+    minimax(obs, &max, &min);
+    cost.setBackend(costfn::kGrid, 0.1);
+    double unrefined = 0;
+    for (int refined = 0; refined <= 1; refined++) {
+        pso solver(cost, min, max, 60, 200, 2);
+        solver.setRuns(2);
+        solver.setSeed(7);
+        solver.setRefine(refined);
+        std::vector<double> params = solver.run();
+        double analytic = cost.analytic(&params[0], 2);
+        if (refined) {
+            EXPECT_DOUBLE_EQ(analytic, solver.getGMin());
+            EXPECT_LE(analytic, unrefined);
+        }
+        unrefined = analytic;
+    }
+}
+
+int main(int argc, char **argv) {
+    setLogLevel(kLogWarn);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,159 @@
+/*
+ * test_sample_log.cc
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: mike
+ */
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "radbot_processor/sample_log.h"
+
+//on disk layout, see sampleLog::header and sampleLog::record
+static const off_t kHeaderBytes = 64;
+static const off_t kRecordBytes = 40;
+
+class SampleLogTest : public testing::Test
+{
+protected:
+    virtual void SetUp() {
+        char path[] = "/tmp/radbot_sample_log_XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        ::close(fd);
+        unlink(path); //sampleLog creates it
+        path_ = path;
+    }
+    virtual void TearDown() {
+        unlink(path_.c_str());
+    }
+
+    static sample make(int i) {
+        sample s;
+        s.x = i * 0.5;
+        s.y = -i * 0.25;
+        s.counts = 100 + i;
+        s.weight = 1 + i % 3;
+        return s;
+    }
+    static void expectSample(const sample &a, const sample &b) {
+        EXPECT_EQ(a.x, b.x);
+        EXPECT_EQ(a.y, b.y);
+        EXPECT_EQ(a.counts, b.counts);
+        EXPECT_EQ(a.weight, b.weight);
+    }
+    void appendSamples(sampleLog &log, int first, int count) {
+        for (int i = first; i < first + count; i++)
+            ASSERT_TRUE(log.append(make(i)));
+    }
+    void overwrite(off_t offset, char byte) {
+        int fd = ::open(path_.c_str(), O_RDWR);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(1, pwrite(fd, &byte, 1, offset));
+        ::close(fd);
+    }
+
+    std::string path_;
+};
+
+TEST_F(SampleLogTest, ReopenReadsBack) {
+    {
+        sampleLog log;
+        ASSERT_TRUE(log.open(path_));
+        EXPECT_EQ(0u, log.size());
+        appendSamples(log, 0, 10);
+    }
+    sampleLog log;
+    ASSERT_TRUE(log.open(path_));
+    ASSERT_EQ(10u, log.size());
+    std::vector<sample> out;
+    log.read(out);
+    ASSERT_EQ(10u, out.size());
+    for (int i = 0; i < 10; i++)
+        expectSample(make(i), out[i]);
+}
+
+// The mapping starts at 4096 records and doubles.
+TEST_F(SampleLogTest, GrowsPastInitialCapacity) {
+    {
+        sampleLog log;
+        ASSERT_TRUE(log.open(path_));
+        appendSamples(log, 0, 10000);
+    }
+    sampleLog log;
+    ASSERT_TRUE(log.open(path_));
+    ASSERT_EQ(10000u, log.size());
+    std::vector<sample> out;
+    log.read(out);
+    expectSample(make(9999), out[9999]);
+}
+
+// A record failing its CRC ends the log, later records are dropped and
+// new appends follow the valid prefix.
+TEST_F(SampleLogTest, RecoversValidPrefix) {
+    {
+        sampleLog log;
+        ASSERT_TRUE(log.open(path_));
+        appendSamples(log, 0, 20);
+    }
+    overwrite(kHeaderBytes + 12 * kRecordBytes + 3, 0x5a);
+    {
+        sampleLog log;
+        ASSERT_TRUE(log.open(path_));
+        ASSERT_EQ(12u, log.size());
+        appendSamples(log, 100, 2);
+    }
+    sampleLog log;
+    ASSERT_TRUE(log.open(path_));
+    ASSERT_EQ(14u, log.size());
+    std::vector<sample> out;
+    log.read(out);
+    expectSample(make(11), out[11]);
+    expectSample(make(100), out[12]);
+    expectSample(make(101), out[13]);
+}
+
+TEST_F(SampleLogTest, RejectsOtherFiles) {
+    FILE *f = fopen(path_.c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    fprintf(f, "1.0,2.0,300\n");
+    fclose(f);
+    sampleLog log;
+    EXPECT_FALSE(log.open(path_));
+    EXPECT_FALSE(log.isOpen());
+    EXPECT_FALSE(log.append(make(0)));
+}
+
+TEST_F(SampleLogTest, RejectsDamagedHeader) {
+    {
+        sampleLog log;
+        ASSERT_TRUE(log.open(path_));
+        appendSamples(log, 0, 3);
+    }
+    overwrite(9, 0x7f); //version
+    sampleLog log;
+    EXPECT_FALSE(log.open(path_));
+}
+
+TEST_F(SampleLogTest, ClearDropsRecords) {
+    {
+        sampleLog log;
+        ASSERT_TRUE(log.open(path_));
+        appendSamples(log, 0, 50);
+        ASSERT_TRUE(log.clear());
+        EXPECT_EQ(0u, log.size());
+        appendSamples(log, 7, 1);
+    }
+    sampleLog log;
+    ASSERT_TRUE(log.open(path_));
+    ASSERT_EQ(1u, log.size());
+    std::vector<sample> out;
+    log.read(out);
+    expectSample(make(7), out[0]);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}